@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "colorschemecatalog.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSettings>
+#include <QStandardPaths>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+static QStringList schemeDirectories()
+{
+    return QStandardPaths::locateAll(QStandardPaths::GenericDataLocation,
+                                     QLatin1String("qtermwidget5/color-schemes"),
+                                     QStandardPaths::LocateDirectory);
+}
+
+static QColor schemeColor(QSettings &scheme, const QString &group)
+{
+    // "Color=r,g,b" is read back as a string list by QSettings.
+    const QStringList rgb = scheme.value(group + QLatin1String("/Color")).toStringList();
+    if (rgb.size() != 3)
+        return QColor();
+    return QColor(rgb.at(0).toInt(), rgb.at(1).toInt(), rgb.at(2).toInt());
+}
+
+static ColorSchemeCatalog::Palette parsePalette(const QString &fileName)
+{
+    QSettings scheme(fileName, QSettings::IniFormat);
+    ColorSchemeCatalog::Palette palette;
+    palette.foreground = schemeColor(scheme, QLatin1String("Foreground"));
+    palette.background = schemeColor(scheme, QLatin1String("Background"));
+    for (int i = 0; i < 8; ++i)
+        palette.colors.append(schemeColor(scheme, QString("Color%1").arg(i)));
+    return palette;
+}
+
+ColorSchemeCatalog::ColorSchemeCatalog(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_indexed(false)
+{
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            this, &ColorSchemeCatalog::directoryChanged);
+}
+
+QStringList ColorSchemeCatalog::schemes()
+{
+    index();
+    return m_schemes;
+}
+
+ColorSchemeCatalog::Palette ColorSchemeCatalog::palette(const QString &scheme)
+{
+    index();
+
+    const QString fileName = m_files.value(scheme);
+    if (fileName.isEmpty())
+        return Palette();
+
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+    auto it = m_palettes.find(scheme);
+    if (it == m_palettes.end() || it->lastModified != lastModified)
+        it = m_palettes.insert(scheme, {lastModified, parsePalette(fileName)});
+    return it->palette;
+}
+
+/*! Returns what to pass to QTermWidget::setColorScheme() for \a scheme.
+
+    The terminal indexes its schemes only once, a scheme that was added
+    later is passed by file name once. The terminal keeps the scheme it
+    loaded from the file, all further terminals get its name, so that the
+    file is not parsed again for every terminal.
+*/
+QString ColorSchemeCatalog::terminalScheme(const QString &scheme)
+{
+    index();
+
+    if (!m_builtinSchemes.contains(scheme) && m_passedByFile.contains(scheme))
+        m_builtinSchemes = QTermWidget::availableColorSchemes();
+
+    if (m_builtinSchemes.contains(scheme))
+        return scheme;
+
+    const QString fileName = m_files.value(scheme);
+    if (fileName.isEmpty())
+        return scheme;
+    m_passedByFile.insert(scheme);
+    return fileName;
+}
+
+void ColorSchemeCatalog::index()
+{
+    if (m_indexed)
+        return;
+    m_indexed = true;
+
+    if (m_builtinSchemes.isEmpty())
+        m_builtinSchemes = QTermWidget::availableColorSchemes();
+
+    m_files.clear();
+    const QStringList directories = schemeDirectories();
+    for (const QString &directory : directories) {
+        const QFileInfoList files = QDir(directory).entryInfoList({QLatin1String("*.colorscheme")},
+                                                                  QDir::Files | QDir::Readable);
+        for (const QFileInfo &file : files) {
+            if (!m_files.contains(file.completeBaseName()))
+                m_files.insert(file.completeBaseName(), file.absoluteFilePath());
+        }
+    }
+
+    QStringList schemes = m_builtinSchemes + m_files.keys();
+    schemes.sort();
+    schemes.removeDuplicates();
+    m_schemes = schemes;
+
+    const QStringList watched = m_watcher->directories();
+    if (!watched.isEmpty())
+        m_watcher->removePaths(watched);
+    if (!directories.isEmpty())
+        m_watcher->addPaths(directories);
+}
+
+void ColorSchemeCatalog::directoryChanged()
+{
+    m_indexed = false;
+    emit schemesChanged();
+}
+
+} // namespace Internal
+} // namespace Terminal
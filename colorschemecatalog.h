@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef COLORSCHEMECATALOG_H
+#define COLORSCHEMECATALOG_H
+
+#include <QColor>
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QFileSystemWatcher)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Index of the available terminal color schemes.
+
+    The scheme directories are scanned once, on first use, and watched for
+    changes afterwards. Parsed palettes are cached per scheme and only
+    parsed again when their file changes.
+*/
+class ColorSchemeCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Palette
+    {
+        QColor foreground;
+        QColor background;
+        QVector<QColor> colors;
+
+        bool isValid() const { return foreground.isValid() && background.isValid(); }
+    };
+
+    explicit ColorSchemeCatalog(QObject *parent = nullptr);
+
+    QStringList schemes();
+    Palette palette(const QString &scheme);
+    QString terminalScheme(const QString &scheme);
+
+signals:
+    void schemesChanged();
+
+private:
+    struct CachedPalette
+    {
+        QDateTime lastModified;
+        Palette palette;
+    };
+
+    void index();
+    void directoryChanged();
+
+    QFileSystemWatcher *m_watcher;
+    bool m_indexed;
+    QStringList m_schemes;
+    // The schemes the terminal knows by name.
+    QStringList m_builtinSchemes;
+    QSet<QString> m_passedByFile;
+    QHash<QString, QString> m_files;
+    QHash<QString, CachedPalette> m_palettes;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // COLORSCHEMECATALOG_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "diagnosticsparser.h"
+#include "ptyiothread.h"
+#include "scrollbackstore.h"
+#include "terminalgeometry.h"
+
+#include <projectexplorer/taskhub.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QKeyEvent>
+#include <QRegularExpression>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <cstring>
+
+namespace Terminal {
+namespace Internal {
+
+// Longer lines are not diagnostics, they are skipped.
+static const int maxLineBytes = 64 * 1024;
+static const int maxTasks = 1000;
+static const int maxContinuationLines = 50;
+
+static bool categoryRegistered = false;
+
+// file:line[:column]: error|warning: message
+static const QRegularExpression &gccPattern()
+{
+    static const QRegularExpression pattern(
+                "^(.+?):(\\d+):(?:\\d+:)?\\s+(fatal error|error|warning):\\s+(.*)$",
+                QRegularExpression::OptimizeOnFirstUsageOption);
+    return pattern;
+}
+
+// tool: error|warning: message, e.g. "clang: error: linker command failed"
+static const QRegularExpression &toolPattern()
+{
+    static const QRegularExpression pattern(
+                "^([^\\s:]+): (fatal error|error|warning): (.*)$",
+                QRegularExpression::OptimizeOnFirstUsageOption);
+    return pattern;
+}
+
+// CMake Error|Warning [(dev)] [at file:line (command)]:
+static const QRegularExpression &cmakePattern()
+{
+    static const QRegularExpression pattern(
+                "^CMake (Error|Warning)(?: \\(dev\\))?(?: at (.+):(\\d+) \\((.+)\\))?:?\\s*(.*)$",
+                QRegularExpression::OptimizeOnFirstUsageOption);
+    return pattern;
+}
+
+DiagnosticsParser::DiagnosticsParser(QTermWidget *terminal)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_taskCount(0)
+    , m_alternateScreen(false)
+{
+    if (!categoryRegistered) {
+        ProjectExplorer::TaskHub::addCategory(taskCategory(), tr("Terminal"));
+        categoryRegistered = true;
+    }
+
+    connect(terminal, &QTermWidget::receivedData, this, &DiagnosticsParser::dataReceived);
+    TerminalGeometry::display(terminal)->installEventFilter(this);
+}
+
+DiagnosticsParser::~DiagnosticsParser()
+{
+    clearTasks();
+}
+
+DiagnosticsParser *DiagnosticsParser::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<DiagnosticsParser *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+Utils::Id DiagnosticsParser::taskCategory()
+{
+    return "Terminal.Diagnostics";
+}
+
+int DiagnosticsParser::taskCount() const
+{
+    return m_taskCount;
+}
+
+void DiagnosticsParser::clearTasks()
+{
+    for (const ProjectExplorer::Task &task : qAsConst(m_tasks))
+        ProjectExplorer::TaskHub::removeTask(task);
+    m_tasks.clear();
+    m_taskCount = 0;
+}
+
+bool DiagnosticsParser::eventFilter(QObject *, QEvent *event)
+{
+    if (event->type() != QEvent::KeyPress)
+        return false;
+
+    // A command is entered, the issues are those of the previous one. On
+    // the alternate screen, Return goes to a program like vim or less.
+    const int key = static_cast<QKeyEvent *>(event)->key();
+    if ((key == Qt::Key_Return || key == Qt::Key_Enter) && !m_alternateScreen) {
+        m_pendingTask = PendingTask();
+        clearTasks();
+    }
+    return false;
+}
+
+void DiagnosticsParser::dataReceived(const QString &data)
+{
+    // The shell may have changed its directory since the last output.
+    m_workingDirectory.clear();
+
+    // receivedData() hands out the raw PTY bytes as Latin-1.
+    const QByteArray bytes = data.toLatin1();
+    updateAlternateScreen(bytes);
+    const char *begin = bytes.constData();
+    const char *end = begin + bytes.size();
+
+    while (begin < end) {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+        if (!newline) {
+            m_partial.append(begin, int(end - begin));
+            if (m_partial.size() > maxLineBytes)
+                m_partial = QByteArray(1, '\0'); // Marks the line as too long.
+            break;
+        }
+
+        if (m_partial.isEmpty()) {
+            parseLine(QByteArray::fromRawData(begin, int(newline - begin)));
+        } else {
+            m_partial.append(begin, int(newline - begin));
+            if (!m_partial.startsWith('\0'))
+                parseLine(m_partial);
+            m_partial.clear();
+        }
+        begin = newline + 1;
+    }
+}
+
+void DiagnosticsParser::parseLine(const QByteArray &rawLine)
+{
+    // Cheap checks first, most lines are none of our business.
+    const bool continuation = !m_pendingTask.description.isEmpty()
+            && (rawLine.isEmpty() || rawLine.startsWith(' ') || rawLine == "\r");
+    // Colors do not split the keywords, they can be looked for in the raw
+    // line.
+    const bool candidate = rawLine.contains("error") || rawLine.contains("warning")
+            || rawLine.startsWith("CMake ") || rawLine.startsWith("FAILED: ");
+    if (!continuation && !candidate) {
+        flushPendingTask();
+        return;
+    }
+
+    QString line = rawLine.contains('\x1b') ? ScrollbackStore::plainText(rawLine)
+                                            : QString::fromUtf8(rawLine);
+    if (line.endsWith('\r'))
+        line.chop(1);
+
+    if (continuation) {
+        const QString text = line.trimmed();
+        if (!text.isEmpty())
+            m_pendingTask.description += '\n' + text;
+        if (m_pendingTask.description.count('\n') >= maxContinuationLines)
+            flushPendingTask();
+        return;
+    }
+    flushPendingTask();
+
+    using ProjectExplorer::Task;
+
+    QRegularExpressionMatch match = gccPattern().match(line);
+    if (match.hasMatch()) {
+        addTask(match.captured(3) == QLatin1String("warning") ? Task::Warning : Task::Error,
+                match.captured(4), match.captured(1), match.captured(2).toInt());
+        return;
+    }
+
+    match = toolPattern().match(line);
+    if (match.hasMatch()) {
+        addTask(match.captured(2) == QLatin1String("warning") ? Task::Warning : Task::Error,
+                match.captured(1) + ": " + match.captured(3), QString(), -1);
+        return;
+    }
+
+    match = cmakePattern().match(line);
+    if (match.hasMatch()) {
+        m_pendingTask.type = match.captured(1) == QLatin1String("Error") ? Task::Error : Task::Warning;
+        m_pendingTask.file = match.captured(2);
+        m_pendingTask.line = match.captured(3).isEmpty() ? -1 : match.captured(3).toInt();
+        m_pendingTask.description = match.captured(4).isEmpty()
+                ? QString("CMake %1").arg(match.captured(1))
+                : QString("CMake %1 in %2()").arg(match.captured(1), match.captured(4));
+        if (!match.captured(5).isEmpty())
+            m_pendingTask.description += ": " + match.captured(5);
+        return;
+    }
+
+    if (line.startsWith(QLatin1String("FAILED: ")))
+        addTask(Task::Error, tr("Build step failed: %1").arg(line.mid(8)), QString(), -1);
+}
+
+void DiagnosticsParser::addTask(ProjectExplorer::Task::TaskType type, const QString &description,
+                                const QString &file, int line)
+{
+    if (m_taskCount > maxTasks)
+        return;
+
+    if (++m_taskCount > maxTasks) {
+        m_tasks.append(ProjectExplorer::Task(
+                ProjectExplorer::Task::Warning,
+                tr("Too many issues in the terminal output, the remaining ones are not shown."),
+                Utils::FilePath(), -1, taskCategory()));
+        ProjectExplorer::TaskHub::addTask(m_tasks.last());
+        return;
+    }
+
+    m_tasks.append(ProjectExplorer::Task(
+            type, description, file.isEmpty() ? Utils::FilePath() : resolve(file), line,
+            taskCategory()));
+    ProjectExplorer::TaskHub::addTask(m_tasks.last());
+}
+
+void DiagnosticsParser::updateAlternateScreen(const QByteArray &data)
+{
+    // DECSET/DECRST of the modes 47, 1047 and 1049. A sequence split
+    // between two reads is missed.
+    int position = 0;
+    while ((position = data.indexOf("\x1b[?", position)) >= 0) {
+        position += 3;
+        int end = position;
+        while (end < data.size() && ((data.at(end) >= '0' && data.at(end) <= '9') || data.at(end) == ';'))
+            ++end;
+        if (end == data.size() || (data.at(end) != 'h' && data.at(end) != 'l'))
+            continue;
+
+        for (const QByteArray &mode : data.mid(position, end - position).split(';')) {
+            if (mode == "47" || mode == "1047" || mode == "1049")
+                m_alternateScreen = data.at(end) == 'h';
+        }
+        position = end;
+    }
+}
+
+void DiagnosticsParser::flushPendingTask()
+{
+    if (m_pendingTask.description.isEmpty())
+        return;
+
+    const PendingTask task = m_pendingTask;
+    m_pendingTask = PendingTask();
+    addTask(task.type, task.description, task.file, task.line);
+}
+
+Utils::FilePath DiagnosticsParser::resolve(const QString &file)
+{
+    if (QFileInfo(file).isAbsolute() || !m_terminal)
+        return Utils::FilePath::fromString(file);
+
+    // Relative paths are relative to where the build runs, i.e. the shell's
+    // current directory.
+    if (m_workingDirectory.isNull())
+        m_workingDirectory = PtyChannel::workingDirectory(m_terminal);
+    return Utils::FilePath::fromString(QDir(m_workingDirectory).absoluteFilePath(file));
+}
+
+} // namespace Internal
+} // namespace Terminal
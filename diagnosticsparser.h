@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef DIAGNOSTICSPARSER_H
+#define DIAGNOSTICSPARSER_H
+
+#include <projectexplorer/task.h>
+
+#include <QByteArray>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Turns compiler diagnostics in a terminal's output into tasks of the
+    Issues pane.
+
+    The parser only sees output as it arrives, it never reads the
+    scrollback. Lines are split with memchr(). A line is only matched
+    against the GCC/Clang, CMake and ninja patterns if it contains one of
+    their keywords, so plain build output costs a couple of byte scans.
+
+    The parser removes its tasks when the next command is entered, i.e. on
+    Return outside of the alternate screen, and when it goes away.
+
+    The parser is a child of the terminal, use forTerminal() to find it.
+*/
+class DiagnosticsParser : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsParser(QTermWidget *terminal);
+    ~DiagnosticsParser();
+
+    static DiagnosticsParser *forTerminal(QTermWidget *terminal);
+    static Utils::Id taskCategory();
+
+    int taskCount() const;
+
+    // Removes the tasks of this parser, the category is shared by all.
+    void clearTasks();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    // A CMake message continues on the following, indented lines.
+    struct PendingTask
+    {
+        ProjectExplorer::Task::TaskType type = ProjectExplorer::Task::Unknown;
+        QString description;
+        QString file;
+        int line = -1;
+    };
+
+    void dataReceived(const QString &data);
+    void parseLine(const QByteArray &line);
+    void addTask(ProjectExplorer::Task::TaskType type, const QString &description,
+                 const QString &file, int line);
+    void flushPendingTask();
+    void updateAlternateScreen(const QByteArray &data);
+    Utils::FilePath resolve(const QString &file);
+
+    QPointer<QTermWidget> m_terminal;
+    QByteArray m_partial;
+    PendingTask m_pendingTask;
+    QString m_workingDirectory;
+    QVector<ProjectExplorer::Task> m_tasks;
+    int m_taskCount;
+    bool m_alternateScreen;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // DIAGNOSTICSPARSER_H
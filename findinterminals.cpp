@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "findinterminals.h"
+#include "scrollbacksearch.h"
+#include "scrollbackstore.h"
+
+#include <coreplugin/find/searchresultitem.h>
+#include <coreplugin/find/searchresultwindow.h>
+#include <utils/runextensions.h>
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFutureWatcher>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QPointer>
+#include <QVBoxLayout>
+#include <QVector>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+// Hits are handed to the Search Results pane every this many lines.
+static const int linesPerBatch = 65536;
+// Stop searching a terminal after this many hits, the pane does not cope
+// well with more and nobody looks at them anyway.
+static const int maxHitsPerTerminal = 10000;
+// Lines shown in the pane are cut down to this many characters.
+static const int maxLineTextLength = 1000;
+
+struct TerminalHit
+{
+    qint64 line;
+    int column;
+    int length;
+    QString text;
+};
+
+using TerminalHits = QVector<TerminalHit>;
+
+static TerminalHit makeHit(const ScrollbackMatch &match, const QString &text)
+{
+    if (text.size() <= maxLineTextLength)
+        return {match.line, match.column, match.length, text};
+
+    const int start = qBound(0, match.column - maxLineTextLength / 4, text.size() - maxLineTextLength);
+    return {match.line, match.column - start, match.length, text.mid(start, maxLineTextLength)};
+}
+
+static void searchTerminal(QFutureInterface<TerminalHits> &futureInterface,
+                           const QSharedPointer<const ScrollbackSearch> &search,
+                           const ScrollbackSnapshot &snapshot)
+{
+    TerminalHits hits;
+    QVector<ScrollbackMatch> matches;
+    int hitCount = 0;
+    int scanned = 0;
+
+    snapshot.forEachLine([&](qint64 line, const QByteArray &rawLine) {
+        if (++scanned % linesPerBatch == 0) {
+            if (futureInterface.isCanceled())
+                return false;
+            if (!hits.isEmpty()) {
+                futureInterface.reportResult(hits);
+                hits.clear();
+            }
+        }
+
+        matches.clear();
+        search->matchLine(line, rawLine, matches);
+        if (matches.isEmpty())
+            return true;
+
+        const QString text = ScrollbackStore::plainText(rawLine);
+        for (const ScrollbackMatch &match : qAsConst(matches)) {
+            hits.append(makeHit(match, text));
+            if (++hitCount >= maxHitsPerTerminal)
+                return false;
+        }
+        return true;
+    });
+
+    if (!hits.isEmpty())
+        futureInterface.reportResult(hits);
+}
+
+/*! One search over all terminals, lives as long as its entry in the Search
+    Results pane.
+*/
+class FindInTerminals::Job : public QObject
+{
+public:
+    Job(FindInTerminals *owner, Core::SearchResult *result)
+        : QObject(result)
+        , m_owner(owner)
+        , m_result(result)
+    {
+        connect(result, &Core::SearchResult::activated, this, &Job::activate);
+        connect(result, &Core::SearchResult::cancelled, this, &Job::cancel);
+    }
+
+    ~Job() override
+    {
+        cancel();
+    }
+
+    void addTerminal(QThreadPool *threadPool,
+                     const QSharedPointer<const ScrollbackSearch> &search,
+                     QTermWidget *terminal,
+                     const QString &name)
+    {
+        ScrollbackStore *store = ScrollbackStore::forTerminal(terminal);
+        if (!store)
+            return;
+
+        const int index = m_terminals.count();
+        m_terminals.append(terminal);
+
+        auto watcher = new QFutureWatcher<TerminalHits>(this);
+        connect(watcher, &QFutureWatcherBase::resultsReadyAt,
+                this, [this, watcher, index, name](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+                addHits(index, name, watcher->resultAt(i));
+        });
+        connect(watcher, &QFutureWatcherBase::finished, this, &Job::terminalFinished);
+        m_watchers.append(watcher);
+        watcher->setFuture(Utils::runAsync(threadPool, &searchTerminal, search, store->snapshot()));
+    }
+
+    void finishIfIdle()
+    {
+        if (m_watchers.isEmpty())
+            m_result->finishSearch(false);
+    }
+
+    void cancel()
+    {
+        m_canceled = true;
+        for (QFutureWatcher<TerminalHits> *watcher : qAsConst(m_watchers))
+            watcher->cancel();
+    }
+
+private:
+    void addHits(int index, const QString &name, const TerminalHits &hits)
+    {
+        // New terminals all have the same name, the number tells them apart.
+        const QStringList path(QString("%1: %2").arg(index + 1).arg(name));
+        QList<Core::SearchResultItem> items;
+        items.reserve(hits.size());
+        for (const TerminalHit &hit : hits) {
+            Core::SearchResultItem item;
+            item.setPath(path);
+            item.setLineText(hit.text);
+            item.setMainRange(int(hit.line + 1), hit.column, hit.length);
+            item.setUseTextEditorFont(true);
+            item.setUserData(QVariantList{index, hit.line, hit.column, hit.length});
+            items.append(item);
+        }
+        m_result->addResults(items, Core::SearchResult::AddOrdered);
+    }
+
+    void terminalFinished()
+    {
+        if (++m_finished < m_watchers.count())
+            return;
+        m_result->finishSearch(m_canceled);
+    }
+
+    void activate(const Core::SearchResultItem &item)
+    {
+        const QVariantList data = item.userData().toList();
+        if (data.size() != 4 || !m_owner)
+            return;
+        QTermWidget *terminal = m_terminals.value(data.at(0).toInt());
+        if (!terminal)
+            return;
+        emit m_owner->activated(terminal, data.at(1).toLongLong(), data.at(2).toInt(), data.at(3).toInt());
+    }
+
+    QPointer<FindInTerminals> m_owner;
+    Core::SearchResult *m_result;
+    QVector<QPointer<QTermWidget>> m_terminals;
+    QVector<QFutureWatcher<TerminalHits> *> m_watchers;
+    int m_finished = 0;
+    bool m_canceled = false;
+};
+
+FindInTerminals::FindInTerminals(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FindInTerminals::~FindInTerminals()
+{
+    for (Job *job : qAsConst(m_jobs)) {
+        if (job)
+            job->cancel();
+    }
+    m_threadPool.waitForDone();
+}
+
+bool FindInTerminals::askForQuery(QWidget *parent)
+{
+    QDialog dialog(parent);
+    dialog.setWindowTitle(tr("Find in All Terminals"));
+
+    auto patternEdit = new QLineEdit(m_pattern, &dialog);
+    patternEdit->selectAll();
+    auto caseSensitive = new QCheckBox(tr("Case sensitive"), &dialog);
+    caseSensitive->setChecked(m_flags & Core::FindCaseSensitively);
+    auto regexp = new QCheckBox(tr("Regular expression"), &dialog);
+    regexp->setChecked(m_flags & Core::FindRegularExpression);
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    auto layout = new QVBoxLayout(&dialog);
+    layout->addWidget(patternEdit);
+    layout->addWidget(caseSensitive);
+    layout->addWidget(regexp);
+    layout->addWidget(buttons);
+
+    if (dialog.exec() != QDialog::Accepted || patternEdit->text().isEmpty())
+        return false;
+
+    Core::FindFlags flags;
+    if (caseSensitive->isChecked())
+        flags |= Core::FindCaseSensitively;
+    if (regexp->isChecked())
+        flags |= Core::FindRegularExpression;
+
+    if (!ScrollbackSearch(patternEdit->text(), flags).isValid()) {
+        QMessageBox::warning(parent, tr("Find in All Terminals"),
+                             tr("\"%1\" is not a valid regular expression.").arg(patternEdit->text()));
+        return false;
+    }
+
+    m_pattern = patternEdit->text();
+    m_flags = flags;
+    return true;
+}
+
+void FindInTerminals::start(const QList<Target> &terminals)
+{
+    Core::SearchResult *result = Core::SearchResultWindow::instance()->startNewSearch(
+                tr("Terminals"), tr("Find in all terminals"), m_pattern,
+                Core::SearchResultWindow::SearchOnly,
+                Core::SearchResultWindow::PreserveCaseDisabled);
+
+    auto search = QSharedPointer<const ScrollbackSearch>::create(m_pattern, m_flags);
+    auto job = new Job(this, result);
+    m_jobs.append(job);
+    m_jobs.removeAll(nullptr);
+
+    for (const Target &target : terminals)
+        job->addTerminal(&m_threadPool, search, target.first, target.second);
+    job->finishIfIdle();
+
+    Core::SearchResultWindow::instance()->popup(
+                Core::IOutputPane::ModeSwitch | Core::IOutputPane::WithFocus);
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef FINDINTERMINALS_H
+#define FINDINTERMINALS_H
+
+#include <coreplugin/find/textfindconstants.h>
+
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QPointer>
+#include <QThreadPool>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QWidget)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Searches the output history of several terminals at once and shows the
+    hits in the Search Results pane.
+
+    Every terminal is searched in its own job on a private thread pool. Hits
+    are added to the pane while the jobs are still running, grouped by the
+    name of the terminal's tab. Activating a hit emits activated().
+*/
+class FindInTerminals : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Target = QPair<QTermWidget *, QString>;
+
+    explicit FindInTerminals(QObject *parent = nullptr);
+    ~FindInTerminals();
+
+    bool askForQuery(QWidget *parent);
+    void start(const QList<Target> &terminals);
+
+signals:
+    void activated(QTermWidget *terminal, qint64 line, int column, int length);
+
+private:
+    class Job;
+
+    QThreadPool m_threadPool;
+    QList<QPointer<Job>> m_jobs;
+    QString m_pattern;
+    Core::FindFlags m_flags;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // FINDINTERMINALS_H
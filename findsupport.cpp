@@ -2,24 +2,64 @@
  * Copyright (C) 2017 Francois Ferrand. All rights reserved.
  */
 #include "findsupport.h"
+#include "scrollbackstore.h"
+#include "terminalgeometry.h"
+
+#include <utils/runextensions.h>
+
+#include <QFutureWatcher>
 #include <QLineEdit>
 #include <QMenu>
 #include <QToolButton>
+#include <QToolTip>
 #include <qtermwidget5/qtermwidget.h>
 
-#include <QDebug>
+#include <algorithm>
+
 using namespace Terminal::Internal;
 
+// New output of up to this many lines is searched right away on the GUI
+// thread, anything larger goes to a background thread.
+static const qint64 synchronousSearchLines = 20000;
+
+static bool matchBefore(const ScrollbackMatch &match, const ScrollbackMatch &other)
+{
+    return match.line < other.line || (match.line == other.line && match.column < other.column);
+}
+
 FindSupport::FindSupport(QTermWidget * termWidget)
+    : m_textEdit(nullptr)
+    , m_matchCaseAction(nullptr)
+    , m_regexpAction(nullptr)
+    , m_highlightAllAction(nullptr)
+    , m_watcher(new QFutureWatcher<QVector<ScrollbackMatch>>(this))
+    , m_searchedUntil(-1)
+    , m_pendingUntil(-1)
+    , m_currentMatch(-1)
+{
+    connect(m_watcher, &QFutureWatcherBase::finished, this, &FindSupport::searchFinished);
+
+    if (termWidget)
+        setTerminal(termWidget);
+}
+
+FindSupport::~FindSupport()
 {
-    setTerminal(termWidget);
+    m_watcher->cancel();
+    m_watcher->waitForFinished();
 }
 
 void FindSupport::setTerminal(QTermWidget * termWidget)
 {
+    if (!termWidget || termWidget == m_terminal)
+        return;
+
+    m_terminal = termWidget;
+    resetSearch();
+
+    // The terminal's own search bar is only used to highlight all matches
+    // on the screen, searching is done on the scrollback store.
     m_textEdit = termWidget->findChild<QLineEdit *>("searchTextEdit");
-    m_findPreviousButton = termWidget->findChild<QToolButton *>("findPreviousButton");
-    m_findNextButton = termWidget->findChild<QToolButton *>("findNextButton");
 
     auto options = termWidget->findChild<QToolButton *>("optionsButton")->menu()->actions();
     m_matchCaseAction = options[0];
@@ -39,7 +79,12 @@ Core::FindFlags FindSupport::supportedFindFlags() const
 
 QString FindSupport::currentFindString() const
 {
-    return m_textEdit->text();
+    if (!m_terminal)
+        return QString();
+    const QString selection = m_terminal->selectedText(false);
+    if (selection.contains('\n'))
+        return QString();
+    return selection;
 }
 
 QString FindSupport::completedFindString() const
@@ -49,41 +94,158 @@ QString FindSupport::completedFindString() const
 
 void FindSupport::clearHighlights()
 {
+    if (!m_highlightAllAction)
+        return;
     m_highlightAllAction->setChecked(false);
 }
 
 void FindSupport::resetIncrementalSearch()
 {
-    m_textEdit->clear();
+    m_currentMatch = -1;
 }
 
 void FindSupport::highlightAll(const QString & txt, Core::FindFlags findFlags)
 {
+    if (!m_textEdit)
+        return;
     setupSearch(txt, findFlags);
     m_highlightAllAction->setChecked(true);
 }
 
 Core::IFindSupport::Result FindSupport::findIncremental(const QString & txt, Core::FindFlags findFlags)
 {
-    setupSearch(txt, findFlags);
-    m_highlightAllAction->setChecked(false);
-    m_result = Found;
-    if (findFlags & Core::FindBackward)
-        m_findPreviousButton->click();
-    else
-        m_findNextButton->click();
-    return m_result;
+    return find(txt, findFlags, false);
 }
 
 Core::IFindSupport::Result FindSupport::findStep(const QString & txt, Core::FindFlags findFlags)
 {
-    setupSearch(txt, findFlags);
-    m_result = Found;
-    if (findFlags & Core::FindBackward)
-        m_findPreviousButton->click();
+    return find(txt, findFlags, true);
+}
+
+int FindSupport::matchCount() const
+{
+    return m_matches.count();
+}
+
+Core::IFindSupport::Result FindSupport::find(const QString & txt, Core::FindFlags findFlags, bool step)
+{
+    if (!m_terminal || !ScrollbackStore::forTerminal(m_terminal))
+        return NotFound;
+    if (txt.isEmpty()) {
+        resetSearch();
+        return NotFound;
+    }
+
+    // The find toolbar polls again while we answer NotYetFound.
+    if (!updateMatches(txt, findFlags))
+        return NotYetFound;
+
+    if (!m_search->isValid() || m_matches.isEmpty()) {
+        m_currentMatch = -1;
+        return NotFound;
+    }
+
+    const bool backward = findFlags & Core::FindBackward;
+    if (m_currentMatch < 0) {
+        // A new search starts at the most recent output.
+        m_currentMatch = m_matches.count() - 1;
+    } else if (step) {
+        m_currentMatch += backward ? -1 : 1;
+        if (m_currentMatch < 0 || m_currentMatch >= m_matches.count()) {
+            m_currentMatch = backward ? m_matches.count() - 1 : 0;
+            showWrapIndicator(m_terminal);
+        }
+    }
+
+    showMatch();
+    return Found;
+}
+
+// Brings m_matches up to date with the terminal's output. Returns false if
+// a background search has to finish first.
+bool FindSupport::updateMatches(const QString & txt, Core::FindFlags findFlags)
+{
+    const Core::FindFlags queryFlags = findFlags & (Core::FindCaseSensitively | Core::FindRegularExpression);
+    if (!m_search || m_search->pattern() != txt || m_search->flags() != queryFlags) {
+        resetSearch();
+        m_search.reset(new ScrollbackSearch(txt, queryFlags));
+    }
+
+    if (m_watcher->isRunning())
+        return false;
+    if (!m_search->isValid())
+        return true;
+
+    const ScrollbackSnapshot snapshot = ScrollbackStore::forTerminal(m_terminal)->snapshot();
+    const qint64 from = qMax(m_searchedUntil, snapshot.firstLine());
+    const qint64 to = snapshot.endLine();
+
+    // Forget matches that were dropped from the history, and the ones in
+    // the unfinished last line, which is searched again.
+    const bool hadCurrent = m_currentMatch >= 0 && m_currentMatch < m_matches.count();
+    const ScrollbackMatch current = hadCurrent ? m_matches.at(m_currentMatch) : ScrollbackMatch{-1, 0, 0};
+    auto dropped = std::remove_if(m_matches.begin(), m_matches.end(),
+                                  [&](const ScrollbackMatch &match) {
+        return match.line < snapshot.firstLine() || match.line >= from;
+    });
+    m_matches.erase(dropped, m_matches.end());
+
+    if (from < to) {
+        if (to - from > synchronousSearchLines) {
+            auto search = m_search;
+            m_pendingUntil = snapshot.endsWithPartialLine() ? to - 1 : to;
+            m_watcher->setFuture(Utils::runAsync(
+                [search, snapshot, from, to](QFutureInterface<QVector<ScrollbackMatch>> &fi) {
+                    fi.reportResult(search->search(snapshot, from, to,
+                                                   [&fi] { return fi.isCanceled(); }));
+                }));
+            m_currentMatch = -1;
+            return false;
+        }
+        m_matches += m_search->search(snapshot, from, to);
+        m_searchedUntil = snapshot.endsWithPartialLine() ? to - 1 : to;
+    }
+
+    if (hadCurrent) {
+        auto it = std::lower_bound(m_matches.cbegin(), m_matches.cend(), current, matchBefore);
+        m_currentMatch = qMin(int(it - m_matches.cbegin()), m_matches.count() - 1);
+    }
+    return true;
+}
+
+void FindSupport::searchFinished()
+{
+    const QFuture<QVector<ScrollbackMatch>> future = m_watcher->future();
+    if (future.isCanceled() || future.resultCount() == 0)
+        return;
+    m_matches += future.result();
+    m_searchedUntil = m_pendingUntil;
+}
+
+void FindSupport::showMatch()
+{
+    const ScrollbackMatch &match = m_matches.at(m_currentMatch);
+    const ScrollbackSnapshot snapshot = ScrollbackStore::forTerminal(m_terminal)->snapshot();
+
+    int column = 0;
+    const int line = TerminalGeometry::widgetLine(m_terminal, snapshot, match.line, match.column, &column);
+    QString status = tr("Match %1 of %2").arg(m_currentMatch + 1).arg(m_matches.count());
+    if (line >= 0)
+        TerminalGeometry::reveal(m_terminal, line, column, match.length);
     else
-        m_findNextButton->click();
-    return m_result;
+        status += QLatin1Char('\n') + tr("Line %1 is no longer shown in the terminal.").arg(match.line + 1);
+
+    QToolTip::showText(m_terminal->mapToGlobal(m_terminal->rect().topRight()), status, m_terminal);
+}
+
+void FindSupport::resetSearch()
+{
+    m_watcher->cancel();
+    m_search.reset();
+    m_matches.clear();
+    m_searchedUntil = -1;
+    m_pendingUntil = -1;
+    m_currentMatch = -1;
 }
 
 void FindSupport::setupSearch(const QString & txt, Core::FindFlags findFlags)
@@ -4,13 +4,21 @@
 #ifndef FINDSUPPORT_H
 #define FINDSUPPORT_H
 
+#include "scrollbacksearch.h"
+
 #include <coreplugin/find/ifindsupport.h>
 
+#include <QPointer>
+#include <QSharedPointer>
+
 QT_FORWARD_DECLARE_CLASS(QAction)
 QT_FORWARD_DECLARE_CLASS(QLineEdit)
 QT_FORWARD_DECLARE_CLASS(QTermWidget)
 QT_FORWARD_DECLARE_CLASS(QToolButton)
 
+template <typename T>
+class QFutureWatcher;
+
 namespace Terminal {
 namespace Internal {
 
@@ -19,7 +27,8 @@ class FindSupport : public Core::IFindSupport
     Q_OBJECT
 
 public:
-    FindSupport(QTermWidget * termWidget);
+    FindSupport(QTermWidget * termWidget = nullptr);
+    ~FindSupport();
 
     virtual bool supportsReplace() const override;
     virtual Core::FindFlags supportedFindFlags() const override;
@@ -33,19 +42,31 @@ public:
     virtual Result findIncremental(const QString &txt, Core::FindFlags findFlags) override;
     virtual Result findStep(const QString &txt, Core::FindFlags findFlags) override;
 
+    int matchCount() const;
+
 public slots:
     void setTerminal(QTermWidget * termWidget);
 
 private:
+    Result find(const QString &txt, Core::FindFlags findFlags, bool step);
+    bool updateMatches(const QString &txt, Core::FindFlags findFlags);
+    void searchFinished();
+    void showMatch();
+    void resetSearch();
     void setupSearch(const QString &txt, Core::FindFlags findFlags);
 
+    QPointer<QTermWidget> m_terminal;
     QLineEdit * m_textEdit;
-    QToolButton * m_findPreviousButton;
-    QToolButton * m_findNextButton;
     QAction * m_matchCaseAction;
     QAction * m_regexpAction;
     QAction * m_highlightAllAction;
-    Result m_result;
+
+    QSharedPointer<const ScrollbackSearch> m_search;
+    QFutureWatcher<QVector<ScrollbackMatch>> * m_watcher;
+    QVector<ScrollbackMatch> m_matches;
+    qint64 m_searchedUntil;
+    qint64 m_pendingUntil;
+    int m_currentMatch;
 };
 
 } // namespace Internal
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "hibernator.h"
+#include "scrollbackstore.h"
+#include "terminalgeometry.h"
+
+#include <QEvent>
+#include <QTimer>
+#include <QVector>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace Terminal {
+namespace Internal {
+
+// What a history line costs in the widget: a Character per cell, and the
+// line's vector.
+static const int cellBytes = 16;
+static const int historyLineOverhead = 32;
+
+static qint64 s_totalSavedBytes = 0;
+
+Hibernator::Hibernator(QTermWidget *terminal, int historyLines)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_display(TerminalGeometry::display(terminal))
+    , m_savedBytes(0)
+    , m_historyLines(historyLines)
+    , m_fileLines(0)
+    , m_hibernated(false)
+    , m_historyInFile(false)
+{
+    m_idle.start();
+    connect(terminal, &QTermWidget::receivedData, this, &Hibernator::dataReceived);
+    terminal->installEventFilter(this);
+}
+
+Hibernator::~Hibernator()
+{
+    setSavedBytes(0);
+}
+
+Hibernator *Hibernator::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<Hibernator *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+qint64 Hibernator::totalSavedBytes()
+{
+    return s_totalSavedBytes;
+}
+
+void Hibernator::releaseFreedMemory()
+{
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+    // Freed memory is otherwise kept for reuse by the process.
+    malloc_trim(0);
+#endif
+}
+
+qint64 Hibernator::idleMilliseconds() const
+{
+    return m_idle.elapsed();
+}
+
+bool Hibernator::isHibernated() const
+{
+    return m_hibernated;
+}
+
+qint64 Hibernator::savedBytes() const
+{
+    return m_savedBytes;
+}
+
+void Hibernator::hibernate()
+{
+    if (m_hibernated || !m_terminal)
+        return;
+
+    qint64 saved = 0;
+    if (ScrollbackStore *store = ScrollbackStore::forTerminal(m_terminal)) {
+        const qint64 before = store->memoryBytes();
+        store->flush();
+        saved += before - store->memoryBytes();
+    }
+
+    // Woken up, but not painted yet, the history is still in the file.
+    if (m_display)
+        m_display->removeEventFilter(this);
+    if (!m_historyInFile) {
+        saved += historyMemoryBytes();
+        m_fileLines = m_terminal->historyLinesCount();
+        // The widget copies the lines over to a temporary file and frees
+        // them.
+        m_terminal->setHistorySize(-1);
+        m_historyInFile = true;
+    }
+
+    m_hibernated = true;
+    setSavedBytes(saved);
+    emit hibernatedChanged(true);
+}
+
+void Hibernator::wake()
+{
+    if (!m_hibernated)
+        return;
+
+    m_hibernated = false;
+    m_idle.restart();
+    setSavedBytes(0);
+
+    // The screen is all the first frame needs.
+    if (m_display)
+        m_display->installEventFilter(this);
+    else
+        restoreHistory();
+
+    emit hibernatedChanged(false);
+}
+
+bool Hibernator::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_terminal.data()) {
+        if (event->type() == QEvent::Hide)
+            m_idle.restart();
+    } else if (watched == m_display.data() && event->type() == QEvent::Paint) {
+        m_display->removeEventFilter(this);
+        QTimer::singleShot(0, this, &Hibernator::restoreHistory);
+    }
+    return false;
+}
+
+void Hibernator::dataReceived(const QString &data)
+{
+    m_idle.restart();
+    if (!m_historyInFile)
+        return;
+
+    // The file based history has no limit. Once it has grown by the size
+    // of the memory based one, it is cut back to that size, which copies
+    // the lines kept through memory to a new file.
+    m_fileLines += data.count('\n');
+    if (m_fileLines <= 2 * qint64(m_historyLines))
+        return;
+    m_terminal->setHistorySize(m_historyLines);
+    m_terminal->setHistorySize(-1);
+    m_fileLines = m_terminal->historyLinesCount();
+}
+
+void Hibernator::restoreHistory()
+{
+    if (m_hibernated || !m_historyInFile || !m_terminal)
+        return;
+
+    // Copies the last lines of the file back into memory.
+    m_terminal->setHistorySize(m_historyLines);
+    m_historyInFile = false;
+}
+
+qint64 Hibernator::historyMemoryBytes() const
+{
+    const int historyLines = m_terminal->historyLinesCount();
+    ScrollbackStore *store = ScrollbackStore::forTerminal(m_terminal);
+    if (historyLines <= 0 || !store)
+        return 0;
+
+    // The history holds the output's last lines, except for those on the
+    // screen. Every output line has at least one row.
+    const int columns = qMax(1, m_terminal->screenColumnsCount());
+    const ScrollbackSnapshot snapshot = store->snapshot();
+    const qint64 first = qMax(snapshot.firstLine(),
+                              snapshot.endLine() - historyLines - m_terminal->screenLinesCount());
+    QVector<int> widths;
+    widths.reserve(int(snapshot.endLine() - first));
+    snapshot.forEachLine(first, snapshot.endLine(), [&widths](qint64, const QByteArray &rawLine) {
+        widths.append(rawLine.contains('\x1b') ? ScrollbackStore::plainText(rawLine).size()
+                                               : rawLine.size());
+        return true;
+    });
+
+    int screenRows = m_terminal->screenLinesCount();
+    int rows = 0;
+    qint64 bytes = 0;
+    for (int i = widths.size() - 1; i >= 0 && rows < historyLines; --i) {
+        const int lineRows = qMax(1, (widths.at(i) + columns - 1) / columns);
+        if (screenRows > 0) {
+            screenRows -= lineRows;
+            continue;
+        }
+        rows += lineRows;
+        bytes += qint64(widths.at(i)) * cellBytes + lineRows * historyLineOverhead;
+    }
+    return bytes;
+}
+
+void Hibernator::setSavedBytes(qint64 bytes)
+{
+    s_totalSavedBytes += bytes - m_savedBytes;
+    m_savedBytes = bytes;
+}
+
+} // namespace Internal
+} // namespace Terminal
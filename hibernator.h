@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef HIBERNATOR_H
+#define HIBERNATOR_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Reclaims the memory of a terminal that nobody looks at.
+
+    A hibernated terminal has its scrollback compressed to disk and its
+    history moved from memory to the widget's file based history. Its shell
+    and screen stay as they are, so it keeps taking output. The file is cut
+    back to the terminal's history size as it grows. Waking it up
+    only has to paint the screen, the history is read back into memory
+    after the first frame.
+
+    The memory saved is estimated when hibernating, from the lines that
+    are moved out.
+
+    The hibernator is a child of the terminal, use forTerminal() to find it.
+*/
+class Hibernator : public QObject
+{
+    Q_OBJECT
+
+public:
+    Hibernator(QTermWidget *terminal, int historyLines);
+    ~Hibernator();
+
+    static Hibernator *forTerminal(QTermWidget *terminal);
+    static qint64 totalSavedBytes();
+    // Hands the memory freed by hibernate() back to the system. Walks the
+    // whole heap, call it once after hibernating a batch of terminals.
+    static void releaseFreedMemory();
+
+    // Time since the terminal got output or was hidden.
+    qint64 idleMilliseconds() const;
+
+    bool isHibernated() const;
+    qint64 savedBytes() const;
+
+    void hibernate();
+    void wake();
+
+signals:
+    void hibernatedChanged(bool hibernated);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void dataReceived(const QString &data);
+    void restoreHistory();
+    qint64 historyMemoryBytes() const;
+    void setSavedBytes(qint64 bytes);
+
+    QPointer<QTermWidget> m_terminal;
+    QPointer<QWidget> m_display;
+    QElapsedTimer m_idle;
+    qint64 m_savedBytes;
+    int m_historyLines;
+    qint64 m_fileLines;
+    bool m_hibernated;
+    bool m_historyInFile;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // HIBERNATOR_H
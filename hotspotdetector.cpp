@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "hotspotdetector.h"
+#include "projectfileindex.h"
+#include "ptyiothread.h"
+#include "scrollbackstore.h"
+#include "terminalgeometry.h"
+
+#include <projectexplorer/projecttree.h>
+#include <utils/runextensions.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFontMetrics>
+#include <QMouseEvent>
+#include <QRegularExpression>
+#include <QScrollBar>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <cstring>
+
+namespace Terminal {
+namespace Internal {
+
+// Longer lines are not scanned, which bounds the time spent per line.
+static const int maxLineBytes = 2048;
+static const int maxPending = 64;
+static const int maxCached = 2048;
+
+static const QRegularExpression &hotspotPattern()
+{
+    // The repetitions are bounded, so is the backtracking.
+    static const QRegularExpression pattern(
+                "(?<![\\w./\\\\-])((?:[A-Za-z]:)?[\\w.+\\-/\\\\]{0,255}\\w\\.\\w{1,16}):(\\d{1,7})(?::(\\d{1,5}))?",
+                QRegularExpression::OptimizeOnFirstUsageOption);
+    return pattern;
+}
+
+// A colon followed by a digit, the part every hotspot has.
+static bool mayContainHotspot(const char *begin, const char *end)
+{
+    while (begin < end) {
+        const char *colon = static_cast<const char *>(std::memchr(begin, ':', size_t(end - begin)));
+        if (!colon || colon + 1 >= end)
+            return false;
+        if (colon[1] >= '0' && colon[1] <= '9')
+            return true;
+        begin = colon + 1;
+    }
+    return false;
+}
+
+static Utils::FilePath resolveFile(const QString &path,
+                                   const QString &workingDirectory,
+                                   const ProjectFileIndex *fileIndex,
+                                   ProjectExplorer::Project *project)
+{
+    QFileInfo file(path);
+    if (file.isAbsolute())
+        return file.isFile() ? Utils::FilePath::fromString(file.canonicalFilePath()) : Utils::FilePath();
+
+    file = QFileInfo(QDir(workingDirectory), path);
+    if (file.isFile())
+        return Utils::FilePath::fromString(file.canonicalFilePath());
+
+    return fileIndex->findFile(path, project);
+}
+
+HotspotDetector::HotspotDetector(QTermWidget *terminal, const ProjectFileIndex *fileIndex)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_display(TerminalGeometry::display(terminal))
+    , m_fileIndex(fileIndex)
+{
+    connect(terminal, &QTermWidget::receivedData, this, &HotspotDetector::dataReceived);
+    connect(&m_resolver, &QFutureWatcher<Resolved>::finished, this, &HotspotDetector::resolved);
+    m_display->installEventFilter(this);
+}
+
+HotspotDetector::~HotspotDetector()
+{
+    // The resolver reads from the file index.
+    m_resolver.cancel();
+    m_resolver.waitForFinished();
+}
+
+HotspotDetector *HotspotDetector::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<HotspotDetector *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+QVector<HotspotDetector::Hotspot> HotspotDetector::hotspots(const QString &text)
+{
+    QVector<Hotspot> result;
+    QRegularExpressionMatchIterator it = hotspotPattern().globalMatch(text);
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        result.append({match.capturedStart(), match.capturedLength(), match.captured(1),
+                       match.captured(2).toInt(), match.captured(3).toInt()});
+    }
+    return result;
+}
+
+Utils::FilePath HotspotDetector::resolve(const QString &path)
+{
+    // The shell may have changed its directory since the last output.
+    m_workingDirectory.clear();
+    const CacheKey key = cacheKey(path);
+    auto cached = m_cache.constFind(key);
+    if (cached != m_cache.constEnd())
+        return cached.value();
+
+    // Not seen in the output yet, e.g. because the line was too long.
+    const Utils::FilePath file = resolveFile(path, key.first, m_fileIndex,
+                                             ProjectExplorer::ProjectTree::currentProject());
+    m_cache.insert(key, file);
+    return file;
+}
+
+bool HotspotDetector::eventFilter(QObject *, QEvent *event)
+{
+    if (event->type() != QEvent::MouseButtonPress)
+        return false;
+
+    auto mouseEvent = static_cast<QMouseEvent *>(event);
+    if (mouseEvent->button() != Qt::LeftButton || !(mouseEvent->modifiers() & Qt::ControlModifier))
+        return false;
+
+    // Clicks next to a hotspot are left to the terminal, e.g. for links.
+    return activate(mouseEvent->pos());
+}
+
+void HotspotDetector::dataReceived(const QString &data)
+{
+    // The shell may have changed its directory since the last output.
+    m_workingDirectory.clear();
+
+    // receivedData() hands out the raw PTY bytes as Latin-1.
+    const QByteArray bytes = data.toLatin1();
+    const char *begin = bytes.constData();
+    const char *end = begin + bytes.size();
+
+    while (begin < end) {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(end - begin)));
+        if (!newline) {
+            if (m_partial.size() <= maxLineBytes)
+                m_partial.append(begin, int(qMin<qptrdiff>(end - begin, maxLineBytes + 1)));
+            break;
+        }
+
+        if (m_partial.isEmpty()) {
+            scanLine(begin, newline);
+        } else {
+            if (m_partial.size() <= maxLineBytes)
+                m_partial.append(begin, int(qMin<qptrdiff>(newline - begin, maxLineBytes + 1)));
+            scanLine(m_partial.constData(), m_partial.constData() + m_partial.size());
+            m_partial.clear();
+        }
+        begin = newline + 1;
+    }
+
+    resolvePending();
+}
+
+void HotspotDetector::scanLine(const char *begin, const char *end)
+{
+    if (end - begin > maxLineBytes || !mayContainHotspot(begin, end))
+        return;
+
+    const QByteArray rawLine = QByteArray::fromRawData(begin, int(end - begin));
+    const QString text = rawLine.contains('\x1b') ? ScrollbackStore::plainText(rawLine)
+                                                  : QString::fromUtf8(rawLine);
+
+    for (const Hotspot &hotspot : hotspots(text)) {
+        if (m_pending.size() >= maxPending)
+            return;
+        const CacheKey key = cacheKey(hotspot.path);
+        if (!m_cache.contains(key) && !m_pending.contains(key))
+            m_pending.append(key);
+    }
+}
+
+void HotspotDetector::resolvePending()
+{
+    if (m_pending.isEmpty() || m_resolver.isRunning())
+        return;
+
+    const QVector<CacheKey> keys = m_pending;
+    m_pending.clear();
+
+    const ProjectFileIndex *fileIndex = m_fileIndex;
+    ProjectExplorer::Project *project = ProjectExplorer::ProjectTree::currentProject();
+    m_resolver.setFuture(Utils::runAsync([keys, fileIndex, project] {
+        Resolved resolved;
+        for (const CacheKey &key : keys)
+            resolved.append({key, resolveFile(key.second, key.first, fileIndex, project)});
+        return resolved;
+    }));
+}
+
+void HotspotDetector::resolved()
+{
+    const QFuture<Resolved> future = m_resolver.future();
+    if (future.isCanceled() || future.resultCount() == 0)
+        return;
+
+    if (m_cache.size() > maxCached)
+        m_cache.clear();
+    for (const QPair<CacheKey, Utils::FilePath> &entry : future.result())
+        m_cache.insert(entry.first, entry.second);
+
+    // More may have come in meanwhile.
+    resolvePending();
+}
+
+HotspotDetector::CacheKey HotspotDetector::cacheKey(const QString &path)
+{
+    // Relative paths resolve differently once the shell changed its
+    // directory, they are cached per directory.
+    if (QDir::isAbsolutePath(path))
+        return {QString(), path};
+    if (m_workingDirectory.isNull())
+        m_workingDirectory = PtyChannel::workingDirectory(m_terminal);
+    return {m_workingDirectory, path};
+}
+
+bool HotspotDetector::activate(const QPoint &position)
+{
+    if (!m_terminal)
+        return false;
+
+    // The display draws every character in a cell of the same size, with a
+    // margin of one pixel. See TerminalDisplay::fontChange().
+    static const char repeatedCharacters[]
+            = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefgjijklmnopqrstuvwxyz0123456789./+@";
+    const QFontMetrics metrics(m_display->font());
+    const int cellWidth = qMax(1, qRound(double(metrics.horizontalAdvance(QLatin1String(repeatedCharacters)))
+                                         / qstrlen(repeatedCharacters)));
+    const int cellHeight = qMax(1, metrics.height());
+    const int column = (position.x() - 1) / cellWidth;
+    const int row = (position.y() - 1) / cellHeight;
+
+    auto scrollBar = m_terminal->findChild<QScrollBar *>();
+    const int widgetLine = (scrollBar ? scrollBar->value() : 0) + row;
+
+    // There is no API for the text of a line, but there is one for the
+    // text of a selection. The user's selection is put back afterwards.
+    int startRow = 0, startColumn = 0, endRow = 0, endColumn = 0;
+    const bool hadSelection = !m_terminal->selectedText(false).isEmpty();
+    if (hadSelection) {
+        m_terminal->getSelectionStart(startRow, startColumn);
+        m_terminal->getSelectionEnd(endRow, endColumn);
+    }
+
+    m_terminal->setSelectionStart(widgetLine, 0);
+    m_terminal->setSelectionEnd(widgetLine, m_terminal->screenColumnsCount() - 1);
+    const QString text = m_terminal->selectedText(false);
+
+    if (hadSelection) {
+        m_terminal->setSelectionStart(startRow, startColumn);
+        m_terminal->setSelectionEnd(endRow, endColumn);
+    } else {
+        m_terminal->clearSelection();
+    }
+
+    for (const Hotspot &hotspot : hotspots(text)) {
+        if (column < hotspot.start || column >= hotspot.start + hotspot.length)
+            continue;
+
+        const Utils::FilePath file = resolve(hotspot.path);
+        if (file.isEmpty())
+            return false;
+        emit activated(file, hotspot.line, hotspot.column);
+        return true;
+    }
+    return false;
+}
+
+} // namespace Internal
+} // namespace Terminal
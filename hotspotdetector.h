@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef HOTSPOTDETECTOR_H
+#define HOTSPOTDETECTOR_H
+
+#include <utils/filepath.h>
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+class ProjectFileIndex;
+
+/*! Makes "path:line[:column]" in a terminal's output Ctrl+clickable.
+
+    Output lines are scanned as they arrive. Only lines of bounded length
+    that contain a colon followed by a digit are matched against the
+    pattern, so the cost per line stays small whatever the output. The
+    paths found are resolved in the background, against the shell's
+    directory and the project file index, and cached. A click then only
+    has to look at the clicked line.
+
+    The detector is a child of the terminal, use forTerminal() to find it.
+*/
+class HotspotDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Hotspot
+    {
+        int start;      // Position in the line of text
+        int length;
+        QString path;
+        int line;
+        int column;     // 0 if there is none
+    };
+
+    HotspotDetector(QTermWidget *terminal, const ProjectFileIndex *fileIndex);
+    ~HotspotDetector();
+
+    static HotspotDetector *forTerminal(QTermWidget *terminal);
+    static QVector<Hotspot> hotspots(const QString &text);
+
+    Utils::FilePath resolve(const QString &path);
+
+signals:
+    void activated(const Utils::FilePath &file, int line, int column);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    // The shell's directory, empty for absolute paths, and the path.
+    using CacheKey = QPair<QString, QString>;
+    using Resolved = QVector<QPair<CacheKey, Utils::FilePath>>;
+
+    void dataReceived(const QString &data);
+    void scanLine(const char *begin, const char *end);
+    void resolvePending();
+    void resolved();
+    CacheKey cacheKey(const QString &path);
+    bool activate(const QPoint &position);
+
+    QPointer<QTermWidget> m_terminal;
+    QPointer<QWidget> m_display;
+    const ProjectFileIndex *m_fileIndex;
+    QByteArray m_partial;
+    QString m_workingDirectory;
+    QVector<CacheKey> m_pending;
+    QHash<CacheKey, Utils::FilePath> m_cache;
+    QFutureWatcher<Resolved> m_resolver;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // HOTSPOTDETECTOR_H
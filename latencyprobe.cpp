@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "latencyprobe.h"
+#include "ptyiothread.h"
+#include "terminalgeometry.h"
+
+#include <utils/qtcassert.h>
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QJsonArray>
+#include <QKeyEvent>
+#include <QTimer>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace Terminal {
+namespace Internal {
+
+static const char readyMarker[] = "qtc-latency-probe-ready";
+static const int startTimeoutMs = 10000;
+static const int sampleTimeoutMs = 1000;
+// Pause between two samples, so that a sample does not wait for the
+// previous frame.
+static const int sampleIntervalMs = 20;
+
+LatencyProbe::LatencyProbe(QTermWidget *terminal, QObject *parent)
+    : QObject(parent)
+    , m_terminal(terminal)
+    , m_timeout(new QTimer(this))
+    , m_sampleCount(0)
+    , m_sent(0)
+    , m_timeouts(0)
+    , m_running(false)
+    , m_ready(false)
+    , m_echoed(false)
+{
+    m_timeout->setSingleShot(true);
+    connect(m_timeout, &QTimer::timeout, this, &LatencyProbe::sampleTimedOut);
+}
+
+LatencyProbe::~LatencyProbe()
+{
+    if (m_display)
+        m_display->removeEventFilter(this);
+}
+
+void LatencyProbe::start(const QStringList &environment, int sampleCount)
+{
+    QTC_ASSERT(m_terminal && !m_running, return);
+
+    m_samples.clear();
+    m_errorString.clear();
+    m_sampleCount = sampleCount;
+    m_sent = 0;
+    m_timeouts = 0;
+    m_running = true;
+    m_ready = false;
+    m_echoed = false;
+
+    // cat echoes every key as it arrives once the PTY is raw, like a shell
+    // with line editing does.
+    QString escapedMarker;
+    for (const char *c = readyMarker; *c; ++c)
+        escapedMarker += QString("\\%1").arg(int(*c), 3, 8, QChar('0'));
+    m_terminal->setBlinkingCursor(false);
+
+    connect(m_terminal, &QTermWidget::receivedData, this, &LatencyProbe::dataReceived);
+    m_display = TerminalGeometry::display(m_terminal);
+    m_display->installEventFilter(this);
+
+    m_clock.start();
+    m_timeout->start(startTimeoutMs);
+    // Started like the shells, so that the keystrokes take the same path,
+    // through the PTY I/O thread if that is enabled.
+    PtyChannel::startShellProgram(m_terminal, environment, "/bin/sh",
+                                  {"-c", QString("stty raw -echo; printf '%1'; exec cat").arg(escapedMarker)});
+}
+
+bool LatencyProbe::isRunning() const
+{
+    return m_running;
+}
+
+QVector<double> LatencyProbe::samples() const
+{
+    return m_samples;
+}
+
+int LatencyProbe::timeouts() const
+{
+    return m_timeouts;
+}
+
+QString LatencyProbe::errorString() const
+{
+    return m_errorString;
+}
+
+double LatencyProbe::percentile(double p) const
+{
+    if (m_samples.isEmpty())
+        return -1;
+    const int index = qBound(0, int(std::ceil(p / 100 * m_samples.size())) - 1, m_samples.size() - 1);
+    return m_samples.at(index);
+}
+
+QString LatencyProbe::summary() const
+{
+    if (!m_errorString.isEmpty())
+        return m_errorString;
+    if (m_samples.isEmpty())
+        return tr("No keystroke was echoed.");
+
+    QString summary = tr("Keystroke to screen latency over %n keystroke(s):", nullptr, m_samples.size())
+            + '\n'
+            + tr("min %1 ms, median %2 ms, p99 %3 ms, max %4 ms")
+              .arg(m_samples.first(), 0, 'f', 2)
+              .arg(percentile(50), 0, 'f', 2)
+              .arg(percentile(99), 0, 'f', 2)
+              .arg(m_samples.last(), 0, 'f', 2);
+    if (m_timeouts)
+        summary += '\n' + tr("%n keystroke(s) timed out.", nullptr, m_timeouts);
+    return summary;
+}
+
+QJsonObject LatencyProbe::toJson() const
+{
+    QJsonObject result;
+    result.insert("keystrokes", m_samples.size());
+    result.insert("timeouts", m_timeouts);
+    if (!m_errorString.isEmpty())
+        result.insert("error", m_errorString);
+    if (!m_samples.isEmpty()) {
+        result.insert("minMs", m_samples.first());
+        result.insert("medianMs", percentile(50));
+        result.insert("p99Ms", percentile(99));
+        result.insert("maxMs", m_samples.last());
+    }
+    return result;
+}
+
+bool LatencyProbe::eventFilter(QObject *watched, QEvent *event)
+{
+    if (!m_echoed || event->type() != QEvent::Paint)
+        return false;
+
+    // The sample ends once the echo is on screen, i.e. right after the
+    // display has painted, before anything else queued runs.
+    watched->event(event);
+    m_samples.append(m_clock.nsecsElapsed() / 1e6);
+    m_echoed = false;
+    m_timeout->stop();
+    emit progress(m_sent, m_sampleCount);
+    QTimer::singleShot(sampleIntervalMs, this, &LatencyProbe::sendKey);
+    return true;
+}
+
+void LatencyProbe::dataReceived(const QString &data)
+{
+    if (!m_running)
+        return;
+
+    if (!m_ready) {
+        m_readyBuffer += data.toLatin1();
+        if (!m_readyBuffer.contains(readyMarker))
+            return;
+        m_readyBuffer.clear();
+        m_ready = true;
+        m_timeout->stop();
+        QTimer::singleShot(sampleIntervalMs, this, &LatencyProbe::sendKey);
+        return;
+    }
+
+    if (m_timeout->isActive() && data.contains(m_expected))
+        m_echoed = true;
+}
+
+void LatencyProbe::sendKey()
+{
+    if (!m_running || !m_terminal)
+        return;
+    if (m_sent == m_sampleCount) {
+        finish();
+        return;
+    }
+
+    const int letter = m_sent++ % 26;
+    m_expected = QChar('a' + letter);
+    QKeyEvent press(QEvent::KeyPress, Qt::Key_A + letter, Qt::NoModifier, QString(m_expected));
+    QKeyEvent release(QEvent::KeyRelease, Qt::Key_A + letter, Qt::NoModifier, QString(m_expected));
+
+    m_timeout->start(sampleTimeoutMs);
+    m_clock.restart();
+    QCoreApplication::sendEvent(m_display, &press);
+    QCoreApplication::sendEvent(m_display, &release);
+}
+
+void LatencyProbe::sampleTimedOut()
+{
+    if (!m_ready) {
+        finish(tr("The echo program did not start."));
+        return;
+    }
+
+    ++m_timeouts;
+    m_echoed = false;
+    emit progress(m_sent, m_sampleCount);
+    sendKey();
+}
+
+void LatencyProbe::finish(const QString &errorString)
+{
+    m_running = false;
+    m_errorString = errorString;
+    m_timeout->stop();
+    if (m_terminal)
+        disconnect(m_terminal, &QTermWidget::receivedData, this, &LatencyProbe::dataReceived);
+    if (m_display)
+        m_display->removeEventFilter(this);
+    std::sort(m_samples.begin(), m_samples.end());
+    emit finished();
+}
+
+} // namespace Internal
+} // namespace Terminal
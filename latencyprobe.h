@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Measures the time from a keystroke to the echoed character on screen.
+
+    The probe runs "cat" on a raw PTY instead of a shell, so every key is
+    echoed back as soon as it arrives. Synthetic key events are sent to the
+    terminal's display, i.e. through the same path as real keystrokes, and
+    a sample ends when the display has painted after the echo was received.
+
+    The terminal has to be visible and must not have been started yet.
+*/
+class LatencyProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LatencyProbe(QTermWidget *terminal, QObject *parent = nullptr);
+    ~LatencyProbe();
+
+    void start(const QStringList &environment, int sampleCount = 200);
+    bool isRunning() const;
+
+    // Latencies in milliseconds, sorted.
+    QVector<double> samples() const;
+    int timeouts() const;
+    QString errorString() const;
+
+    double percentile(double p) const;
+    QString summary() const;
+    QJsonObject toJson() const;
+
+signals:
+    void progress(int done, int total);
+    void finished();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void dataReceived(const QString &data);
+    void sendKey();
+    void sampleTimedOut();
+    void finish(const QString &errorString = QString());
+
+    QPointer<QTermWidget> m_terminal;
+    QPointer<QWidget> m_display;
+    QTimer *m_timeout;
+    QElapsedTimer m_clock;
+    QVector<double> m_samples;
+    QByteArray m_readyBuffer;
+    QString m_errorString;
+    QChar m_expected;
+    int m_sampleCount;
+    int m_sent;
+    int m_timeouts;
+    bool m_running;
+    bool m_ready;
+    bool m_echoed;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // LATENCYPROBE_H
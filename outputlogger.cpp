@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "outputlogger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(logLog, "qtc.terminal.log", QtWarningMsg)
+
+static const int ringBytes = 4 * 1024 * 1024;
+// The writer is woken up early once a buffer is filled this far, otherwise
+// it looks at the buffers every idleWaitMs.
+static const int wakeThreshold = ringBytes / 4;
+static const int idleWaitMs = 100;
+static const int drainChunkBytes = 64 * 1024;
+static const int closeTimeoutMs = 2000;
+static const int updateIntervalMs = 1000;
+// Rotated logs are compressed in members of this size.
+static const int gzipMemberBytes = 1024 * 1024;
+
+/* Byte ring buffer with one producer and one consumer thread. The positions
+   only grow, their difference is the number of bytes in the buffer. */
+class ByteRing
+{
+public:
+    explicit ByteRing(int capacity)
+        : m_buffer(capacity, Qt::Uninitialized)
+        , m_mask(quint64(capacity) - 1)
+    {
+        Q_ASSERT((capacity & (capacity - 1)) == 0);
+    }
+
+    int size() const
+    {
+        return int(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+    }
+
+    // Producer side. Returns the number of bytes that fitted.
+    int write(const char *data, int size)
+    {
+        const quint64 head = m_head.load(std::memory_order_relaxed);
+        const quint64 tail = m_tail.load(std::memory_order_acquire);
+        const int count = qMin(size, int(m_buffer.size() - (head - tail)));
+        copy(head, count, [this, data](int offset, int from, int length) {
+            std::memcpy(m_buffer.data() + offset, data + from, size_t(length));
+        });
+        m_head.store(head + quint64(count), std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side. Returns the number of bytes read.
+    int read(char *data, int maxSize)
+    {
+        const quint64 tail = m_tail.load(std::memory_order_relaxed);
+        const quint64 head = m_head.load(std::memory_order_acquire);
+        const int count = qMin(maxSize, int(head - tail));
+        copy(tail, count, [this, data](int offset, int from, int length) {
+            std::memcpy(data + from, m_buffer.constData() + offset, size_t(length));
+        });
+        m_tail.store(tail + quint64(count), std::memory_order_release);
+        return count;
+    }
+
+private:
+    // Splits [position, position + count) at the end of the buffer.
+    template <typename Copy>
+    void copy(quint64 position, int count, const Copy &copyPart) const
+    {
+        const int offset = int(position & m_mask);
+        const int first = qMin(count, m_buffer.size() - offset);
+        copyPart(offset, 0, first);
+        if (first < count)
+            copyPart(0, first, count - first);
+    }
+
+    QByteArray m_buffer;
+    const quint64 m_mask;
+    std::atomic<quint64> m_head{0};
+    std::atomic<quint64> m_tail{0};
+};
+
+static quint32 crc32(quint32 crc, const QByteArray &data)
+{
+    static const QVector<quint32> table = [] {
+        QVector<quint32> table(256);
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = (value & 1) ? 0xedb88320 ^ (value >> 1) : value >> 1;
+            table[int(i)] = value;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (const char c : data)
+        crc = table.at(int((crc ^ uchar(c)) & 0xff)) ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendLittleEndian(QByteArray *data, quint32 value)
+{
+    for (int i = 0; i < 4; ++i)
+        data->append(char((value >> (8 * i)) & 0xff));
+}
+
+/* Writes source to target in gzip format. qCompress() wraps zlib's deflate
+   output in a length and a zlib header and trailer, the deflate data in
+   between is what a gzip member holds. Every gzipMemberBytes of the source
+   become a member of their own, which gzip reads as one file. */
+static bool gzipFile(const QString &source, const QString &target)
+{
+    static const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+
+    QFile in(source);
+    QSaveFile out(target);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly))
+        return false;
+
+    do {
+        const QByteArray data = in.read(gzipMemberBytes);
+        // The empty input is one stored block, qCompress() has nothing for
+        // it.
+        const QByteArray compressed = qCompress(data, 1);
+        const QByteArray deflated = data.isEmpty() ? QByteArray("\x03\x00", 2)
+                                                   : compressed.mid(6, compressed.size() - 10);
+        QByteArray member(header, sizeof header);
+        member += deflated;
+        appendLittleEndian(&member, crc32(0, data));
+        appendLittleEndian(&member, quint32(data.size()));
+        if (out.write(member) != member.size())
+            return false;
+    } while (!in.atEnd());
+
+    return in.error() == QFile::NoError && out.commit();
+}
+
+class LogSink
+{
+public:
+    LogSink(const QString &fileName, const OutputLogger::Rotation &rotation)
+        : ring(ringBytes)
+        , fileName(fileName)
+        , rotation(rotation)
+    {}
+
+    // Shared between the threads.
+    ByteRing ring;
+    const QString fileName;
+    const OutputLogger::Rotation rotation;
+    std::atomic<qint64> written{0};
+    std::atomic<qint64> dropped{0};
+    std::atomic<bool> closing{false};
+    QSemaphore closed;
+
+    // Only used by the writer thread.
+    void drain(char *buffer, int size);
+
+private:
+    bool open();
+    void write(const char *data, int size);
+    void rotate();
+    static bool moveFile(const QString &from, const QString &to);
+    QString rotatedFileName(int number) const;
+
+    QFile m_file;
+    qint64 m_fileBytes = 0;
+    qint64 m_droppedNoted = 0;
+    bool m_failed = false;
+};
+
+void LogSink::drain(char *buffer, int size)
+{
+    if (!m_file.isOpen() && !open()) {
+        while (ring.read(buffer, size) > 0) {}
+        return;
+    }
+
+    const qint64 droppedBytes = dropped.load();
+    if (droppedBytes != m_droppedNoted) {
+        const QByteArray note = QString("\r\n[%1 bytes of output were not logged]\r\n")
+                .arg(droppedBytes - m_droppedNoted).toLatin1();
+        write(note.constData(), note.size());
+        m_droppedNoted = droppedBytes;
+    }
+
+    int count;
+    while ((count = ring.read(buffer, size)) > 0)
+        write(buffer, count);
+    m_file.flush();
+}
+
+bool LogSink::open()
+{
+    if (m_failed)
+        return false;
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCWarning(logLog, "Cannot open terminal log %s: %s",
+                  qPrintable(fileName), qPrintable(m_file.errorString()));
+        m_failed = true;
+        return false;
+    }
+    m_fileBytes = m_file.size();
+    return true;
+}
+
+void LogSink::write(const char *data, int size)
+{
+    if (m_file.write(data, size) != size && !m_failed) {
+        qCWarning(logLog, "Cannot write terminal log %s: %s",
+                  qPrintable(fileName), qPrintable(m_file.errorString()));
+        m_failed = true;
+    }
+    m_fileBytes += size;
+    written += size;
+
+    if (rotation.maxFileBytes > 0 && m_fileBytes >= rotation.maxFileBytes)
+        rotate();
+}
+
+void LogSink::rotate()
+{
+    m_file.close();
+
+    // Rotated files that could not be compressed keep their name, both
+    // names have to be moved.
+    const QStringList suffixes = rotation.compress ? QStringList{".gz", QString()}
+                                                   : QStringList{QString()};
+    for (const QString &suffix : suffixes)
+        QFile::remove(rotatedFileName(rotation.keepFiles) + suffix);
+    for (int number = rotation.keepFiles - 1; number >= 1; --number) {
+        for (const QString &suffix : suffixes)
+            moveFile(rotatedFileName(number) + suffix, rotatedFileName(number + 1) + suffix);
+    }
+
+    if (rotation.keepFiles > 0 && moveFile(fileName, rotatedFileName(1))) {
+        // Done before the next rotation can touch the file. The other logs
+        // wait meanwhile, their ring buffers take up their output.
+        if (rotation.compress) {
+            if (gzipFile(rotatedFileName(1), rotatedFileName(1) + ".gz")) {
+                QFile::remove(rotatedFileName(1));
+            } else {
+                qCWarning(logLog, "Cannot compress terminal log %s",
+                          qPrintable(rotatedFileName(1)));
+            }
+        }
+    } else {
+        QFile::remove(fileName);
+    }
+
+    open();
+}
+
+// Renames from to to, replacing to. A file that cannot be renamed is
+// removed, it would otherwise keep growing or take the place of a newer
+// one.
+bool LogSink::moveFile(const QString &from, const QString &to)
+{
+    if (!QFile::exists(from))
+        return false;
+
+    QFile::remove(to);
+    if (QFile::rename(from, to))
+        return true;
+
+    qCWarning(logLog, "Cannot rename terminal log %s to %s, removing it",
+              qPrintable(from), qPrintable(to));
+    QFile::remove(from);
+    return false;
+}
+
+QString LogSink::rotatedFileName(int number) const
+{
+    return fileName + '.' + QString::number(number);
+}
+
+/* Drains the buffers of all loggers. The thread ends when the last logger
+   has been closed and is started again by the next one. */
+class LogWriter : public QThread
+{
+public:
+    static LogWriter &instance()
+    {
+        static LogWriter writer;
+        return writer;
+    }
+
+    void add(const QSharedPointer<LogSink> &sink)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sinks.append(sink);
+        if (!m_running) {
+            // The thread may still be on its way out.
+            wait();
+            m_running = true;
+            start(QThread::LowPriority);
+        }
+    }
+
+    void wake()
+    {
+        m_wakeUp.wakeOne();
+    }
+
+protected:
+    void run() override
+    {
+        QByteArray buffer(drainChunkBytes, Qt::Uninitialized);
+
+        forever {
+            QVector<QSharedPointer<LogSink>> sinks;
+            {
+                QMutexLocker locker(&m_mutex);
+                sinks = m_sinks;
+            }
+
+            for (const QSharedPointer<LogSink> &sink : qAsConst(sinks)) {
+                // Read before draining, everything written before closing
+                // is then part of this drain.
+                const bool closing = sink->closing.load();
+                sink->drain(buffer.data(), buffer.size());
+                if (closing) {
+                    {
+                        QMutexLocker locker(&m_mutex);
+                        m_sinks.removeOne(sink);
+                    }
+                    sink->closed.release();
+                }
+            }
+
+            QMutexLocker locker(&m_mutex);
+            if (m_sinks.isEmpty()) {
+                m_running = false;
+                return;
+            }
+            m_wakeUp.wait(&m_mutex, idleWaitMs);
+        }
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    QVector<QSharedPointer<LogSink>> m_sinks;
+    bool m_running = false;
+};
+
+OutputLogger::OutputLogger(QTermWidget *terminal, const QString &fileName, const Rotation &rotation)
+    : QObject(terminal)
+    , m_sink(new LogSink(fileName, rotation))
+    , m_updateTimer(new QTimer(this))
+    , m_reportedBytes(-1)
+{
+    LogWriter::instance().add(m_sink);
+
+    connect(terminal, &QTermWidget::receivedData, this, &OutputLogger::dataReceived);
+
+    // The size is polled, the writer thread does not talk to the GUI.
+    m_updateTimer->setInterval(updateIntervalMs);
+    connect(m_updateTimer, &QTimer::timeout, this, [this] {
+        const qint64 bytes = bytesWritten();
+        if (bytes != m_reportedBytes) {
+            m_reportedBytes = bytes;
+            emit bytesWrittenChanged(bytes);
+        }
+    });
+    m_updateTimer->start();
+}
+
+OutputLogger::~OutputLogger()
+{
+    m_sink->closing = true;
+    LogWriter::instance().wake();
+    if (!m_sink->closed.tryAcquire(1, closeTimeoutMs))
+        qCWarning(logLog, "Terminal log %s is still being written", qPrintable(m_sink->fileName));
+}
+
+OutputLogger *OutputLogger::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<OutputLogger *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+QString OutputLogger::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/terminal-logs";
+}
+
+QString OutputLogger::fileName() const
+{
+    return m_sink->fileName;
+}
+
+qint64 OutputLogger::bytesWritten() const
+{
+    return m_sink->written.load();
+}
+
+qint64 OutputLogger::droppedBytes() const
+{
+    return m_sink->dropped.load();
+}
+
+void OutputLogger::dataReceived(const QString &data)
+{
+    // receivedData() hands out the raw PTY bytes as Latin-1.
+    const QByteArray bytes = data.toLatin1();
+
+    const int queued = m_sink->ring.size();
+    const int written = m_sink->ring.write(bytes.constData(), bytes.size());
+    if (written < bytes.size())
+        m_sink->dropped += bytes.size() - written;
+
+    if (written < bytes.size() || (queued < wakeThreshold && queued + written >= wakeThreshold))
+        LogWriter::instance().wake();
+}
+
+} // namespace Internal
+} // namespace Terminal
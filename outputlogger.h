@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef OUTPUTLOGGER_H
+#define OUTPUTLOGGER_H
+
+#include <QObject>
+#include <QSharedPointer>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace Terminal {
+namespace Internal {
+
+class LogSink;
+
+/*! Copies the raw output of a terminal into a log file.
+
+    The GUI thread only copies the received bytes into a lock-free ring
+    buffer. A writer thread, shared by all loggers, drains the buffers to
+    disk. If the writer falls so far behind that a buffer is full, the
+    output is not held up; the bytes that did not fit are counted and
+    noted in the log instead.
+
+    Log files are rotated once they reach the configured size. Rotated
+    files are numbered (name.1, name.2, ...) and, optionally, compressed
+    to gzip format by the writer thread.
+
+    The logger is a child of the terminal, use forTerminal() to find it.
+*/
+class OutputLogger : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Rotation
+    {
+        qint64 maxFileBytes;
+        int keepFiles;
+        bool compress;
+    };
+
+    OutputLogger(QTermWidget *terminal, const QString &fileName, const Rotation &rotation);
+    ~OutputLogger();
+
+    static OutputLogger *forTerminal(QTermWidget *terminal);
+    static QString defaultDirectory();
+
+    QString fileName() const;
+    // Bytes written to the log so far, including rotated files.
+    qint64 bytesWritten() const;
+    qint64 droppedBytes() const;
+
+signals:
+    void bytesWrittenChanged(qint64 bytes);
+
+private:
+    void dataReceived(const QString &data);
+
+    QSharedPointer<LogSink> m_sink;
+    QTimer *m_updateTimer;
+    qint64 m_reportedBytes;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // OUTPUTLOGGER_H
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "pastestreamer.h"
+#include "ptyiothread.h"
+
+#include <utils/qtcassert.h>
+
+#include <QProgressDialog>
+#include <QTimer>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <sys/ioctl.h>
+
+namespace Terminal {
+namespace Internal {
+
+static const int chunkSize = 4096;
+// The next chunk is written once less than this is waiting to be read.
+static const int maxQueuedBytes = 1024;
+static const int pollIntervalMs = 10;
+static const int progressSteps = 1000;
+
+static const char bracketStart[] = "\x1b[200~";
+static const char bracketEnd[] = "\x1b[201~";
+
+PasteStreamer::PasteStreamer(QTermWidget *terminal)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_timer(new QTimer(this))
+    , m_progress(new QProgressDialog(tr("Pasting into the terminal..."), tr("Cancel"),
+                                     0, progressSteps, terminal))
+    , m_position(0)
+    , m_total(0)
+    , m_written(0)
+    , m_bracketed(false)
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &PasteStreamer::writeNext);
+
+    m_progress->setWindowModality(Qt::WindowModal);
+    m_progress->setMinimumDuration(500);
+    m_progress->setAutoClose(false);
+    m_progress->setAutoReset(false);
+    m_progress->setValue(0);
+    connect(m_progress, &QProgressDialog::canceled, this, &PasteStreamer::cancel);
+
+    // An empty text is only bracketed if the program enabled bracketed
+    // paste mode.
+    QString probe;
+    terminal->bracketText(probe);
+    m_bracketed = !probe.isEmpty();
+    if (m_bracketed)
+        terminal->sendText(QString::fromLatin1(bracketStart));
+}
+
+void PasteStreamer::paste(QTermWidget *terminal, const QString &text)
+{
+    QTC_ASSERT(terminal, return);
+
+    // A new paste is queued behind one that is still running.
+    PasteStreamer *streamer = forTerminal(terminal);
+    if (!streamer)
+        streamer = new PasteStreamer(terminal);
+    streamer->append(text);
+}
+
+PasteStreamer *PasteStreamer::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<PasteStreamer *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void PasteStreamer::cancel()
+{
+    m_pending.clear();
+    m_position = 0;
+    finish();
+}
+
+void PasteStreamer::append(const QString &text)
+{
+    // Same conversion as QTermWidget::pasteClipboard(). The end of the
+    // bracket must not be part of the text, it would end the paste early.
+    QString converted = text;
+    converted.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    converted.replace('\n', '\r');
+    if (m_bracketed)
+        converted.remove(QLatin1String(bracketEnd));
+
+    m_pending.append(converted);
+    m_total += converted.size();
+    if (!m_timer->isActive())
+        m_timer->start(0);
+}
+
+void PasteStreamer::writeNext()
+{
+    if (!m_terminal)
+        return;
+
+    // With a PtyChannel, the terminal's own PTY only passes the input on.
+    qint64 queued = 0;
+    if (PtyChannel *channel = PtyChannel::forTerminal(m_terminal)) {
+        queued = channel->queuedInput();
+    } else {
+        const int slaveFd = m_terminal->getPtySlaveFd();
+        int unread = 0;
+        if (slaveFd >= 0 && ::ioctl(slaveFd, FIONREAD, &unread) == 0)
+            queued = unread;
+    }
+    if (queued > maxQueuedBytes) {
+        m_timer->start(pollIntervalMs);
+        return;
+    }
+
+    int end = qMin(m_position + chunkSize, m_pending.size());
+    if (end < m_pending.size() && m_pending.at(end - 1).isHighSurrogate())
+        --end;
+    m_terminal->sendText(m_pending.mid(m_position, end - m_position));
+    m_written += end - m_position;
+    m_position = end;
+
+    if (m_position == m_pending.size()) {
+        finish();
+        return;
+    }
+
+    // Drop what has been written from time to time, not after every chunk.
+    if (m_position > m_pending.size() / 2) {
+        m_pending.remove(0, m_position);
+        m_position = 0;
+    }
+
+    m_progress->setValue(int(m_written * progressSteps / qMax<qint64>(m_total, 1)));
+    // Gives the PTY a chance to take the chunk before the next check.
+    m_timer->start(1);
+}
+
+void PasteStreamer::finish()
+{
+    m_timer->stop();
+    disconnect(m_progress, nullptr, this, nullptr);
+    if (m_bracketed && m_terminal)
+        m_terminal->sendText(QString::fromLatin1(bracketEnd));
+
+    m_progress->deleteLater();
+    // Makes room for the next paste right away.
+    setParent(nullptr);
+    deleteLater();
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef PASTESTREAMER_H
+#define PASTESTREAMER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+QT_FORWARD_DECLARE_CLASS(QProgressDialog)
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Pastes large texts into a terminal in chunks.
+
+    A chunk is only written once the program in the terminal has read most
+    of the previous ones, which is checked with FIONREAD on the PTY, or
+    with PtyChannel::queuedInput() if the shell has a channel. So the
+    paste never piles up more than a few KiB in front of the program, and
+    the GUI thread only ever converts one chunk at a time.
+
+    The whole text is wrapped into one bracketed paste if the program asked
+    for it. Pastes that take a while show a progress dialog that allows
+    canceling the rest of the paste.
+
+    The streamer is a child of the terminal and deletes itself when done.
+*/
+class PasteStreamer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Smaller texts are pasted at once.
+    static const int streamingThreshold = 64 * 1024;
+
+    static void paste(QTermWidget *terminal, const QString &text);
+    static PasteStreamer *forTerminal(QTermWidget *terminal);
+
+    void cancel();
+
+private:
+    explicit PasteStreamer(QTermWidget *terminal);
+
+    void append(const QString &text);
+    void writeNext();
+    void finish();
+
+    QPointer<QTermWidget> m_terminal;
+    QTimer *m_timer;
+    QProgressDialog *m_progress;
+    QString m_pending;
+    int m_position;
+    qint64 m_total;
+    qint64 m_written;
+    bool m_bracketed;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // PASTESTREAMER_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "perfcounters.h"
+#include "hibernator.h"
+#include "ptyiothread.h"
+#include "scrollbackstore.h"
+#include "terminalgeometry.h"
+
+#include <QEvent>
+#include <QJsonArray>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+// Upper limits in milliseconds of the read to paint latency buckets. The
+// last bucket takes everything above.
+static const QVector<int> bucketLimits = {1, 2, 4, 8, 16, 33, 66, 133, 266, 533, 1066};
+
+static QVector<PerfCounters *> &allCounters()
+{
+    static QVector<PerfCounters *> counters;
+    return counters;
+}
+
+static bool detailedTracking = false;
+
+PerfCounters::PerfCounters(QTermWidget *terminal)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_latencyHistogram(bucketLimits.size() + 1, 0)
+    , m_bytesRead(0)
+    , m_paintCount(0)
+    , m_paintNanoseconds(0)
+    , m_unpaintedSince(-1)
+    , m_tracking(false)
+{
+    m_clock.start();
+    allCounters().append(this);
+
+    connect(terminal, &QTermWidget::receivedData, this, [this](const QString &data) {
+        m_bytesRead += data.size();
+        if (m_tracking && m_unpaintedSince < 0)
+            m_unpaintedSince = m_clock.nsecsElapsed();
+    });
+
+    setTracking(detailedTracking);
+}
+
+PerfCounters::~PerfCounters()
+{
+    allCounters().removeOne(this);
+}
+
+PerfCounters *PerfCounters::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<PerfCounters *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void PerfCounters::setDetailedTracking(bool enabled)
+{
+    detailedTracking = enabled;
+    for (PerfCounters *counters : qAsConst(allCounters()))
+        counters->setTracking(enabled);
+}
+
+qint64 PerfCounters::bytesRead() const
+{
+    return m_bytesRead;
+}
+
+qint64 PerfCounters::paintCount() const
+{
+    return m_paintCount;
+}
+
+double PerfCounters::paintMilliseconds() const
+{
+    return m_paintNanoseconds / 1e6;
+}
+
+QVector<qint64> PerfCounters::latencyHistogram() const
+{
+    return m_latencyHistogram;
+}
+
+QVector<int> PerfCounters::latencyBucketLimits()
+{
+    return bucketLimits;
+}
+
+void PerfCounters::reset()
+{
+    m_latencyHistogram.fill(0);
+    m_bytesRead = 0;
+    m_paintCount = 0;
+    m_paintNanoseconds = 0;
+    m_unpaintedSince = -1;
+}
+
+QJsonObject PerfCounters::toJson() const
+{
+    QJsonObject counters;
+    counters.insert("shellPid", PtyChannel::shellPid(m_terminal));
+    counters.insert("bytesRead", m_bytesRead);
+    counters.insert("paintCount", m_paintCount);
+    counters.insert("paintMs", paintMilliseconds());
+
+    QJsonArray histogram;
+    for (int i = 0; i < m_latencyHistogram.size(); ++i) {
+        QJsonObject bucket;
+        bucket.insert("maxMs", i < bucketLimits.size() ? QJsonValue(bucketLimits.at(i)) : QJsonValue());
+        bucket.insert("count", m_latencyHistogram.at(i));
+        histogram.append(bucket);
+    }
+    counters.insert("readToPaintLatency", histogram);
+
+    if (ScrollbackStore *store = ScrollbackStore::forTerminal(m_terminal)) {
+        counters.insert("scrollbackLines", store->lineCount());
+        counters.insert("scrollbackMemoryBytes", store->memoryBytes());
+        counters.insert("scrollbackDiskBytes", store->diskBytes());
+    }
+    if (Hibernator *hibernator = Hibernator::forTerminal(m_terminal)) {
+        counters.insert("hibernated", hibernator->isHibernated());
+        counters.insert("hibernationSavedBytes", hibernator->savedBytes());
+    }
+    return counters;
+}
+
+bool PerfCounters::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() != QEvent::Paint)
+        return false;
+
+    // Deliver the paint event ourselves to time only the paint. Filters
+    // run newest first, those installed before this one do not see paints
+    // while tracking is on.
+    const qint64 start = m_clock.nsecsElapsed();
+    watched->event(event);
+    const qint64 end = m_clock.nsecsElapsed();
+
+    ++m_paintCount;
+    m_paintNanoseconds += end - start;
+
+    if (m_unpaintedSince >= 0) {
+        const qint64 latencyMs = (end - m_unpaintedSince) / 1000000;
+        int bucket = 0;
+        while (bucket < bucketLimits.size() && latencyMs >= bucketLimits.at(bucket))
+            ++bucket;
+        ++m_latencyHistogram[bucket];
+        m_unpaintedSince = -1;
+    }
+    return true;
+}
+
+void PerfCounters::setTracking(bool tracking)
+{
+    if (m_tracking == tracking)
+        return;
+    m_tracking = tracking;
+
+    if (!m_display)
+        m_display = TerminalGeometry::display(m_terminal);
+
+    if (tracking) {
+        m_display->installEventFilter(this);
+    } else {
+        m_display->removeEventFilter(this);
+        m_unpaintedSince = -1;
+    }
+}
+
+} // namespace Internal
+} // namespace Terminal
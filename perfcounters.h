@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Performance counters of one terminal.
+
+    The bytes read from the PTY are always counted. Paint count, paint time
+    and the latency from reading output to painting it need an event filter
+    on the terminal's display, which is only installed while detailed
+    tracking is enabled, i.e. while somebody looks at the counters.
+
+    The counters are a child of the terminal, use forTerminal() to find them.
+*/
+class PerfCounters : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PerfCounters(QTermWidget *terminal);
+    ~PerfCounters();
+
+    static PerfCounters *forTerminal(QTermWidget *terminal);
+    static void setDetailedTracking(bool enabled);
+
+    qint64 bytesRead() const;
+    qint64 paintCount() const;
+    double paintMilliseconds() const;
+    QVector<qint64> latencyHistogram() const;
+    static QVector<int> latencyBucketLimits();
+
+    void reset();
+    QJsonObject toJson() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void setTracking(bool tracking);
+
+    QTermWidget *m_terminal;
+    QPointer<QWidget> m_display;
+    QElapsedTimer m_clock;
+    QVector<qint64> m_latencyHistogram;
+    qint64 m_bytesRead;
+    qint64 m_paintCount;
+    qint64 m_paintNanoseconds;
+    qint64 m_unpaintedSince;
+    bool m_tracking;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "projectfileindex.h"
+
+#include <projectexplorer/project.h>
+#include <projectexplorer/session.h>
+
+#include <QStringList>
+
+#include <algorithm>
+#include <iterator>
+
+namespace Terminal {
+namespace Internal {
+
+static QStringList pathComponents(const QString &path)
+{
+    QStringList components = path.split('/');
+    // Keep a leading empty component for absolute paths, so that joining
+    // the components back together restores the leading slash.
+    for (int i = components.count() - 1; i > 0; --i) {
+        if (components.at(i).isEmpty() || components.at(i) == QLatin1String("."))
+            components.removeAt(i);
+    }
+    return components;
+}
+
+class ProjectFileIndex::SuffixTrie
+{
+public:
+    ~SuffixTrie() { clear(&m_root); }
+
+    void insert(const Utils::FilePath &file)
+    {
+        const QStringList components = pathComponents(file.toString());
+        Node *node = &m_root;
+        std::vector<Node *> path;
+        for (auto it = components.crbegin(); it != components.crend(); ++it) {
+            Node *&child = node->children[*it];
+            if (!child)
+                child = new Node;
+            node = child;
+            path.push_back(node);
+        }
+        if (node->isFile)
+            return;
+        node->isFile = true;
+        for (Node *n : path)
+            ++n->fileCount;
+    }
+
+    void remove(const Utils::FilePath &file)
+    {
+        const QStringList components = pathComponents(file.toString());
+        Node *node = &m_root;
+        std::vector<std::pair<Node *, QString>> path;
+        for (auto it = components.crbegin(); it != components.crend(); ++it) {
+            Node *child = node->children.value(*it);
+            if (!child)
+                return;
+            path.emplace_back(node, *it);
+            node = child;
+        }
+        if (!node->isFile)
+            return;
+        node->isFile = false;
+
+        // Walk back up, dropping subtrees that no longer hold any file.
+        for (auto it = path.crbegin(); it != path.crend(); ++it) {
+            Node *parent = it->first;
+            Node *child = parent->children.value(it->second);
+            if (--child->fileCount == 0) {
+                parent->children.remove(it->second);
+                clear(child);
+                delete child;
+            }
+        }
+    }
+
+    Utils::FilePath find(const QStringList &suffix) const
+    {
+        const Node *node = &m_root;
+        QStringList reversed;
+        for (auto it = suffix.crbegin(); it != suffix.crend(); ++it) {
+            node = node->children.value(*it);
+            if (!node)
+                return Utils::FilePath();
+            reversed.append(*it);
+        }
+
+        // Any file below the matching node ends with the suffix, so just
+        // follow the first branch until we reach one.
+        while (!node->isFile) {
+            if (node->children.isEmpty())
+                return Utils::FilePath();
+            auto child = node->children.cbegin();
+            reversed.append(child.key());
+            node = child.value();
+        }
+
+        std::reverse(reversed.begin(), reversed.end());
+        return Utils::FilePath::fromString(reversed.join('/'));
+    }
+
+private:
+    struct Node
+    {
+        QHash<QString, Node *> children;
+        int fileCount = 0;
+        bool isFile = false;
+    };
+
+    static void clear(Node *node)
+    {
+        for (Node *child : qAsConst(node->children)) {
+            clear(child);
+            delete child;
+        }
+        node->children.clear();
+    }
+
+    Node m_root;
+};
+
+ProjectFileIndex::ProjectFileIndex(QObject *parent)
+    : QObject(parent)
+{
+    auto session = ProjectExplorer::SessionManager::instance();
+    connect(session, &ProjectExplorer::SessionManager::projectAdded,
+            this, &ProjectFileIndex::addProject);
+    connect(session, &ProjectExplorer::SessionManager::aboutToRemoveProject,
+            this, &ProjectFileIndex::removeProject);
+
+    for (ProjectExplorer::Project *project : ProjectExplorer::SessionManager::projects())
+        addProject(project);
+}
+
+ProjectFileIndex::~ProjectFileIndex()
+{
+    qDeleteAll(m_tries);
+}
+
+Utils::FilePath ProjectFileIndex::findFile(const QString &pathSuffix,
+                                           ProjectExplorer::Project *preferredProject) const
+{
+    QString normalized = pathSuffix.trimmed();
+    normalized.replace('\\', '/');
+
+    QStringList suffix = pathComponents(normalized);
+    if (suffix.isEmpty() || suffix.contains(QLatin1String("..")))
+        return Utils::FilePath();
+    if (suffix.first() == QLatin1String("."))
+        suffix.removeFirst();
+    if (suffix.isEmpty() || suffix.last().isEmpty())
+        return Utils::FilePath();
+
+    QReadLocker locker(&m_lock);
+
+    if (SuffixTrie *trie = m_tries.value(preferredProject)) {
+        const Utils::FilePath file = trie->find(suffix);
+        if (!file.isEmpty())
+            return file;
+    }
+
+    for (auto it = m_tries.cbegin(); it != m_tries.cend(); ++it) {
+        if (it.key() == preferredProject)
+            continue;
+        const Utils::FilePath file = it.value()->find(suffix);
+        if (!file.isEmpty())
+            return file;
+    }
+
+    return Utils::FilePath();
+}
+
+void ProjectFileIndex::addProject(ProjectExplorer::Project *project)
+{
+    if (m_tries.contains(project))
+        return;
+
+    {
+        QWriteLocker locker(&m_lock);
+        m_tries.insert(project, new SuffixTrie);
+    }
+
+    connect(project, &ProjectExplorer::Project::fileListChanged,
+            this, [this, project] { updateProject(project); });
+    updateProject(project);
+}
+
+void ProjectFileIndex::removeProject(ProjectExplorer::Project *project)
+{
+    disconnect(project, nullptr, this, nullptr);
+    m_files.remove(project);
+
+    QWriteLocker locker(&m_lock);
+    delete m_tries.take(project);
+}
+
+void ProjectFileIndex::updateProject(ProjectExplorer::Project *project)
+{
+    Utils::FilePaths files = project->files(ProjectExplorer::Project::AllFiles);
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    // Diff against the previous file list outside of the lock, so lookups
+    // from other threads are only blocked while the trie itself changes.
+    const Utils::FilePaths &oldFiles = m_files[project];
+    Utils::FilePaths added;
+    Utils::FilePaths removed;
+    std::set_difference(files.cbegin(), files.cend(),
+                        oldFiles.cbegin(), oldFiles.cend(),
+                        std::back_inserter(added));
+    std::set_difference(oldFiles.cbegin(), oldFiles.cend(),
+                        files.cbegin(), files.cend(),
+                        std::back_inserter(removed));
+
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        QWriteLocker locker(&m_lock);
+        SuffixTrie *trie = m_tries.value(project);
+        for (const Utils::FilePath &file : qAsConst(removed))
+            trie->remove(file);
+        for (const Utils::FilePath &file : qAsConst(added))
+            trie->insert(file);
+    }
+
+    m_files.insert(project, files);
+}
+
+} // namespace Internal
+} // namespace Terminal
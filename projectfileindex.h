@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef PROJECTFILEINDEX_H
+#define PROJECTFILEINDEX_H
+
+#include <utils/filepath.h>
+
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+
+namespace ProjectExplorer { class Project; }
+
+namespace Terminal {
+namespace Internal {
+
+/*! Suffix index over the files of all open projects.
+
+    Every project gets a trie keyed by reversed path components, so looking
+    up "src/main.cpp" walks "main.cpp" -> "src" and then descends to the first
+    file below that node. A lookup costs about the number of components in
+    the searched path, independent of the project size.
+
+    The index follows ProjectExplorer::Project::fileListChanged() and only
+    inserts or removes the files that actually changed. Lookups may be done
+    from any thread.
+*/
+class ProjectFileIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProjectFileIndex(QObject *parent = nullptr);
+    ~ProjectFileIndex();
+
+    Utils::FilePath findFile(const QString &pathSuffix,
+                             ProjectExplorer::Project *preferredProject = nullptr) const;
+
+private:
+    class SuffixTrie;
+
+    void addProject(ProjectExplorer::Project *project);
+    void removeProject(ProjectExplorer::Project *project);
+    void updateProject(ProjectExplorer::Project *project);
+
+    mutable QReadWriteLock m_lock;
+    QHash<ProjectExplorer::Project *, SuffixTrie *> m_tries;
+    QHash<ProjectExplorer::Project *, Utils::FilePaths> m_files;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // PROJECTFILEINDEX_H
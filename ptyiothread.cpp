@@ -0,0 +1,706 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "ptyiothread.h"
+#include "terminalgeometry.h"
+#include "terminalsettings.h"
+
+#include <utils/qtcassert.h>
+
+#include <QByteArrayList>
+#include <QEvent>
+#include <QFile>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <atomic>
+
+#if defined(Q_OS_LINUX)
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(ptyLog, "qtc.terminal.pty", QtWarningMsg)
+
+static PtyIoThread *s_instance = nullptr;
+
+static const int chunkBytes = 64 * 1024;
+// Read from one shell per wake-up, a busy shell must not starve the others.
+static const int readBudgetBytes = 256 * 1024;
+static const int maxEvents = 64;
+// Input the shell does not read is dropped beyond this.
+static const int maxInputBytes = 1024 * 1024;
+// The keys of the channels' descriptors are their id shifted by one, with
+// the lowest bit telling the two PTYs apart. Ids start at 1.
+static const quint64 wakeUpKey = 0;
+
+class PtyStream
+{
+public:
+    PtyStream()
+    {
+        static quint64 lastId = 0;
+        id = ++lastId;
+    }
+
+    ~PtyStream()
+    {
+#if defined(Q_OS_LINUX)
+        // Closing the shell's PTY hangs up the shell.
+        if (shell >= 0)
+            ::close(shell);
+        if (terminal >= 0)
+            ::close(terminal);
+#endif
+    }
+
+    quint64 id;
+    int shell = -1;     // Master of the shell's PTY
+    QByteArray shellSlaveName;
+    int terminal = -1;  // Slave of the terminal's PTY
+    qint64 pid = -1;
+
+    // Shared between the threads.
+    std::atomic<qint64> buffered{0};
+    QMutex inputMutex;
+    QByteArray input;
+
+    // Only used by the I/O thread.
+    void readShell();
+    void writeOutput();
+    void writeInput();
+    void updateEvents(int epoll);
+
+    bool shellClosed = false;
+    bool terminalClosed = false;
+    bool removed = false;
+    bool finishReported = false;
+
+private:
+    QList<QByteArray> m_output;
+    int m_outputHead = 0;   // Written part of the first chunk
+    int m_outputTail = 0;   // Filled part of the last chunk
+    bool m_inputPending = false;
+    qint64 m_shellEvents = -1;
+    qint64 m_terminalEvents = -1;
+};
+
+#if defined(Q_OS_LINUX)
+
+void PtyStream::readShell()
+{
+    int budget = readBudgetBytes;
+    while (budget > 0 && buffered < PtyIoThread::maxBufferedBytes) {
+        if (m_output.isEmpty() || m_outputTail == chunkBytes) {
+            m_output.append(QByteArray(chunkBytes, Qt::Uninitialized));
+            m_outputTail = 0;
+        }
+
+        const ssize_t count = ::read(shell, m_output.last().data() + m_outputTail,
+                                     size_t(chunkBytes - m_outputTail));
+        if (count > 0) {
+            m_outputTail += int(count);
+            buffered += count;
+            budget -= int(count);
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            // EIO, once the shell and everything it started are gone.
+            shellClosed = true;
+            break;
+        }
+    }
+}
+
+void PtyStream::writeOutput()
+{
+    while (buffered > 0 && !terminalClosed) {
+        const QByteArray &chunk = m_output.first();
+        const int end = m_output.size() == 1 ? m_outputTail : chunk.size();
+        const ssize_t count = ::write(terminal, chunk.constData() + m_outputHead,
+                                      size_t(end - m_outputHead));
+        if (count > 0) {
+            m_outputHead += int(count);
+            buffered -= count;
+            if (m_outputHead == end) {
+                m_output.removeFirst();
+                m_outputHead = 0;
+                if (m_output.isEmpty())
+                    m_outputTail = 0;
+            }
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            terminalClosed = true;
+        }
+    }
+
+    if (terminalClosed) {
+        m_output.clear();
+        m_outputHead = m_outputTail = 0;
+        buffered = 0;
+    }
+}
+
+void PtyStream::writeInput()
+{
+    QMutexLocker locker(&inputMutex);
+    int written = 0;
+    while (written < input.size() && !shellClosed) {
+        const ssize_t count = ::write(shell, input.constData() + written, size_t(input.size() - written));
+        if (count > 0)
+            written += int(count);
+        else if (count < 0 && errno == EINTR)
+            continue;
+        else if (count < 0 && errno == EAGAIN)
+            break;
+        else
+            shellClosed = true; // Reading tells the rest.
+    }
+
+    if (shellClosed)
+        input.clear();
+    else
+        input.remove(0, written);
+    m_inputPending = !input.isEmpty();
+}
+
+static void setEvents(int epoll, int fd, quint64 key, bool closed, qint64 *current, quint32 wanted)
+{
+    // Hang-ups are reported whatever is asked for, closed descriptors
+    // and those nothing is waited for have to go.
+    if (closed || wanted == 0) {
+        if (*current >= 0)
+            epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        *current = -1;
+        return;
+    }
+    if (*current == qint64(wanted))
+        return;
+
+    epoll_event event = {};
+    event.events = wanted;
+    event.data.u64 = key;
+    if (epoll_ctl(epoll, *current < 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) != 0)
+        qCWarning(ptyLog, "Cannot watch PTY: %s", strerror(errno));
+    *current = wanted;
+}
+
+void PtyStream::updateEvents(int epoll)
+{
+    // A full buffer stops the reading, which lets the shell block. A hung
+    // up shell would otherwise keep waking the thread, it is only watched
+    // again once the buffer has room.
+    quint32 shellWanted = 0;
+    if (buffered < PtyIoThread::maxBufferedBytes)
+        shellWanted |= EPOLLIN;
+    if (m_inputPending)
+        shellWanted |= EPOLLOUT;
+    setEvents(epoll, shell, id << 1, shellClosed || removed, &m_shellEvents, shellWanted);
+
+    setEvents(epoll, terminal, (id << 1) | 1, terminalClosed || removed, &m_terminalEvents,
+              buffered > 0 ? EPOLLOUT : 0);
+}
+
+static bool waitForRead(int fd, void *data, size_t size)
+{
+    ssize_t count;
+    do {
+        count = ::read(fd, data, size);
+    } while (count < 0 && errno == EINTR);
+    return count == ssize_t(size);
+}
+
+/* Starts the program on the PTY whose slave is pty. The program is started
+   by an intermediate process that exits right away, which leaves reaping
+   the program to init. Returns the program's process id or -1. */
+static qint64 spawn(int pty, const QString &program, const QStringList &arguments,
+                    const QStringList &environment, const QString &workingDirectory,
+                    QString *errorMessage)
+{
+    // After fork() only async-signal-safe functions may be called, everything
+    // the child needs is prepared before.
+    const QByteArray programData = QFile::encodeName(program);
+    QByteArrayList argumentData{programData};
+    for (const QString &argument : arguments)
+        argumentData.append(argument.toLocal8Bit());
+    QVector<char *> argv;
+    for (QByteArray &argument : argumentData)
+        argv.append(argument.data());
+    argv.append(nullptr);
+
+    QByteArrayList environmentData;
+    for (const QString &variable : environment)
+        environmentData.append(variable.toLocal8Bit());
+    QVector<char *> envp;
+    for (QByteArray &variable : environmentData)
+        envp.append(variable.data());
+    envp.append(nullptr);
+
+    const QByteArray directory = QFile::encodeName(workingDirectory);
+
+    int report[2];
+    if (pipe2(report, O_CLOEXEC) != 0) {
+        *errorMessage = QString::fromLocal8Bit(strerror(errno));
+        return -1;
+    }
+
+    const pid_t child = fork();
+    if (child == 0) {
+        const pid_t shell = fork();
+        if (shell == 0) {
+            setsid();
+            ioctl(pty, TIOCSCTTY, 0);
+            dup2(pty, STDIN_FILENO);
+            dup2(pty, STDOUT_FILENO);
+            dup2(pty, STDERR_FILENO);
+
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigprocmask(SIG_SETMASK, &signals, nullptr);
+            signal(SIGPIPE, SIG_DFL);
+
+            // A shell stays where it is if the directory is gone.
+            if (!directory.isEmpty() && chdir(directory.constData()) != 0) {}
+
+            execve(programData.constData(), argv.data(), envp.data());
+            const int error = errno;
+            const ssize_t ignored = ::write(report[1], &error, sizeof error);
+            Q_UNUSED(ignored)
+            _exit(127);
+        }
+        const ssize_t ignored = ::write(report[1], &shell, sizeof shell);
+        Q_UNUSED(ignored)
+        _exit(0);
+    }
+
+    const int forkError = errno;
+    ::close(report[1]);
+    if (child < 0) {
+        ::close(report[0]);
+        *errorMessage = QString::fromLocal8Bit(strerror(forkError));
+        return -1;
+    }
+    while (waitpid(child, nullptr, 0) < 0 && errno == EINTR) {}
+
+    // The pipe is closed by a successful execve(), otherwise it gets the
+    // error.
+    pid_t shell = -1;
+    int error = 0;
+    const bool forked = waitForRead(report[0], &shell, sizeof shell) && shell > 0;
+    const bool failed = forked && waitForRead(report[0], &error, sizeof error);
+    ::close(report[0]);
+
+    if (!forked || failed) {
+        *errorMessage = QString::fromLocal8Bit(strerror(failed ? error : ECHILD));
+        return -1;
+    }
+    return shell;
+}
+
+#endif // Q_OS_LINUX
+
+PtyChannel::PtyChannel(QTermWidget *terminal, const QSharedPointer<PtyStream> &stream)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_stream(stream)
+{
+    // In teletype mode, the terminal hands out the keystrokes instead of
+    // writing them to its PTY.
+    connect(terminal, &QTermWidget::sendData, this, &PtyChannel::sendInput);
+    connect(PtyIoThread::instance(), &PtyIoThread::shellFinished, this, [this](quint64 streamId) {
+        // The terminal's PTY has no process of its own that could end.
+        if (streamId == m_stream->id && m_terminal)
+            emit m_terminal->finished();
+    });
+
+    if (QWidget *display = TerminalGeometry::display(terminal))
+        display->installEventFilter(this);
+
+    PtyIoThread::instance()->add(stream);
+}
+
+PtyChannel::~PtyChannel()
+{
+    if (PtyIoThread *thread = PtyIoThread::instance())
+        thread->remove(m_stream);
+}
+
+PtyChannel *PtyChannel::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<PtyChannel *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void PtyChannel::startShellProgram(QTermWidget *terminal, const QStringList &environment,
+                                   const QString &program, const QStringList &arguments)
+{
+    if (PtyIoThread::isAvailable() && PtyIoThread::instance()
+            && TerminalSettings::instance()->value("ptyIoThread", false).toBool()
+            && start(terminal, environment, program, arguments)) {
+        return;
+    }
+
+    // The terminal already has the environment.
+    if (!program.isEmpty()) {
+        terminal->setShellProgram(program);
+        terminal->setArgs(arguments);
+    }
+    terminal->startShellProgram();
+}
+
+int PtyChannel::shellPid(QTermWidget *terminal)
+{
+    if (PtyChannel *channel = forTerminal(terminal))
+        return channel->shellPid();
+    return terminal->getShellPID();
+}
+
+QString PtyChannel::workingDirectory(QTermWidget *terminal)
+{
+    PtyChannel *channel = forTerminal(terminal);
+    if (channel) {
+        const QString directory = QFile::symLinkTarget(QString("/proc/%1/cwd").arg(channel->shellPid()));
+        if (!directory.isEmpty())
+            return directory;
+    }
+    // Without a process, this is the initial directory.
+    return terminal->workingDirectory();
+}
+
+int PtyChannel::shellPid() const
+{
+    return int(m_stream->pid);
+}
+
+qint64 PtyChannel::bufferedBytes() const
+{
+    return m_stream->buffered.load();
+}
+
+qint64 PtyChannel::queuedInput() const
+{
+    qint64 queued = 0;
+    {
+        QMutexLocker locker(&m_stream->inputMutex);
+        queued = m_stream->input.size();
+    }
+
+#if defined(Q_OS_LINUX)
+    // Only the slave knows what the shell has not read yet. Keeping it open
+    // would keep the PTY from hanging up once the shell is gone.
+    const int slave = ::open(m_stream->shellSlaveName.constData(),
+                             O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (slave >= 0) {
+        int unread = 0;
+        if (::ioctl(slave, FIONREAD, &unread) == 0)
+            queued += unread;
+        ::close(slave);
+    }
+#endif
+    return queued;
+}
+
+bool PtyChannel::eventFilter(QObject *, QEvent *event)
+{
+    // The terminal's PTY gets the new size once the display has its new
+    // geometry.
+    if (event->type() == QEvent::Resize)
+        QTimer::singleShot(0, this, &PtyChannel::updateWindowSize);
+    return false;
+}
+
+PtyChannel *PtyChannel::start(QTermWidget *terminal, const QStringList &environment,
+                              const QString &program, const QStringList &arguments)
+{
+#if defined(Q_OS_LINUX)
+    const QString shell = program.isEmpty() ? qEnvironmentVariable("SHELL", "/bin/sh") : program;
+    const QString executable = QStandardPaths::findExecutable(shell);
+    if (executable.isEmpty()) {
+        qCWarning(ptyLog, "Cannot find %s", qPrintable(shell));
+        return nullptr;
+    }
+
+    QSharedPointer<PtyStream> stream(new PtyStream);
+
+    // The terminal's PTY only passes the output on.
+    char name[64];
+    if (ttyname_r(terminal->getPtySlaveFd(), name, sizeof name) != 0
+            || (stream->terminal = ::open(name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+        qCWarning(ptyLog, "Cannot open the terminal's PTY: %s", strerror(errno));
+        return nullptr;
+    }
+
+    stream->shell = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (stream->shell < 0 || grantpt(stream->shell) != 0 || unlockpt(stream->shell) != 0
+            || ptsname_r(stream->shell, name, sizeof name) != 0) {
+        qCWarning(ptyLog, "Cannot open a PTY: %s", strerror(errno));
+        return nullptr;
+    }
+    const int slave = ::open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (slave < 0) {
+        qCWarning(ptyLog, "Cannot open %s: %s", name, strerror(errno));
+        return nullptr;
+    }
+    stream->shellSlaveName = name;
+    // Like QTermWidget sets up its PTY.
+    termios settings;
+    if (tcgetattr(slave, &settings) == 0) {
+        settings.c_iflag |= IUTF8;
+        settings.c_cc[VERASE] = 0x7f;
+        tcsetattr(slave, TCSANOW, &settings);
+    }
+    winsize size;
+    if (ioctl(stream->terminal, TIOCGWINSZ, &size) == 0)
+        ioctl(stream->shell, TIOCSWINSZ, &size);
+
+    QString errorMessage;
+    stream->pid = spawn(slave, executable, arguments, environment, terminal->workingDirectory(),
+                        &errorMessage);
+    ::close(slave);
+    if (stream->pid < 0) {
+        qCWarning(ptyLog, "Cannot start %s: %s", qPrintable(executable), qPrintable(errorMessage));
+        return nullptr;
+    }
+    fcntl(stream->shell, F_SETFL, fcntl(stream->shell, F_GETFL) | O_NONBLOCK);
+
+    // The shell's PTY did all the processing already.
+    if (tcgetattr(stream->terminal, &settings) == 0) {
+        cfmakeraw(&settings);
+        tcsetattr(stream->terminal, TCSANOW, &settings);
+    }
+    terminal->startTerminalTeletype();
+    return new PtyChannel(terminal, stream);
+#else
+    Q_UNUSED(terminal)
+    Q_UNUSED(environment)
+    Q_UNUSED(program)
+    Q_UNUSED(arguments)
+    return nullptr;
+#endif
+}
+
+void PtyChannel::sendInput(const char *data, int size)
+{
+    {
+        QMutexLocker locker(&m_stream->inputMutex);
+        if (m_stream->input.size() + size > maxInputBytes) {
+            qCWarning(ptyLog, "The shell %lld does not read its input, dropping %d bytes",
+                      m_stream->pid, size);
+            return;
+        }
+        m_stream->input.append(data, size);
+    }
+    PtyIoThread::instance()->inputQueued(m_stream);
+}
+
+void PtyChannel::updateWindowSize()
+{
+#if defined(Q_OS_LINUX)
+    // The kernel only signals the shell if the size did change.
+    winsize size;
+    if (ioctl(m_stream->terminal, TIOCGWINSZ, &size) == 0)
+        ioctl(m_stream->shell, TIOCSWINSZ, &size);
+#endif
+}
+
+PtyIoThread::PtyIoThread(QObject *parent)
+    : QThread(parent)
+    , m_epoll(-1)
+    , m_wakeUp(-1)
+    , m_quit(false)
+{
+    QTC_CHECK(!s_instance);
+    s_instance = this;
+    setObjectName("Terminal PTY I/O");
+
+#if defined(Q_OS_LINUX)
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeUp = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll < 0 || m_wakeUp < 0) {
+        qCWarning(ptyLog, "Cannot set up the PTY I/O thread: %s", strerror(errno));
+        return;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = wakeUpKey;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeUp, &event);
+#endif
+}
+
+PtyIoThread::~PtyIoThread()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_quit = true;
+    }
+    wake();
+    wait();
+
+#if defined(Q_OS_LINUX)
+    if (m_epoll >= 0)
+        ::close(m_epoll);
+    if (m_wakeUp >= 0)
+        ::close(m_wakeUp);
+#endif
+    s_instance = nullptr;
+}
+
+PtyIoThread *PtyIoThread::instance()
+{
+    return s_instance;
+}
+
+bool PtyIoThread::isAvailable()
+{
+#if defined(Q_OS_LINUX)
+    return s_instance && s_instance->m_epoll >= 0 && s_instance->m_wakeUp >= 0;
+#else
+    return false;
+#endif
+}
+
+void PtyIoThread::add(const QSharedPointer<PtyStream> &stream)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_added.append(stream);
+    }
+    if (!isRunning())
+        start();
+    wake();
+}
+
+void PtyIoThread::remove(const QSharedPointer<PtyStream> &stream)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_removed.append(stream);
+    }
+    wake();
+}
+
+void PtyIoThread::inputQueued(const QSharedPointer<PtyStream> &stream)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        // Typing queues a lot of small pieces, one wake-up does for them.
+        if (m_inputQueued.contains(stream))
+            return;
+        m_inputQueued.append(stream);
+    }
+    wake();
+}
+
+void PtyIoThread::wake()
+{
+#if defined(Q_OS_LINUX)
+    if (m_wakeUp < 0)
+        return;
+    const quint64 one = 1;
+    const ssize_t ignored = ::write(m_wakeUp, &one, sizeof one);
+    Q_UNUSED(ignored)
+#endif
+}
+
+void PtyIoThread::run()
+{
+#if defined(Q_OS_LINUX)
+    QHash<quint64, QSharedPointer<PtyStream>> streams;
+    epoll_event events[maxEvents];
+
+    forever {
+        const int count = epoll_wait(m_epoll, events, maxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            qCWarning(ptyLog, "Cannot wait for the PTYs: %s", strerror(errno));
+            return;
+        }
+
+        QVector<QSharedPointer<PtyStream>> touched;
+        for (int i = 0; i < count; ++i) {
+            const quint64 key = events[i].data.u64;
+            if (key == wakeUpKey) {
+                quint64 value;
+                const ssize_t ignored = ::read(m_wakeUp, &value, sizeof value);
+                Q_UNUSED(ignored)
+
+                QMutexLocker locker(&m_mutex);
+                if (m_quit)
+                    return;
+                for (const QSharedPointer<PtyStream> &stream : qAsConst(m_added)) {
+                    streams.insert(stream->id, stream);
+                    touched.append(stream);
+                }
+                for (const QSharedPointer<PtyStream> &stream : qAsConst(m_removed)) {
+                    stream->removed = true;
+                    stream->updateEvents(m_epoll);
+                    streams.remove(stream->id);
+                }
+                for (const QSharedPointer<PtyStream> &stream : qAsConst(m_inputQueued)) {
+                    if (!stream->removed) {
+                        stream->writeInput();
+                        touched.append(stream);
+                    }
+                }
+                m_added.clear();
+                m_removed.clear();
+                m_inputQueued.clear();
+                continue;
+            }
+
+            const QSharedPointer<PtyStream> stream = streams.value(key >> 1);
+            if (!stream)
+                continue;
+            if (key & 1) {
+                if (events[i].events & (EPOLLHUP | EPOLLERR))
+                    stream->terminalClosed = true;
+            } else {
+                if (events[i].events & EPOLLOUT)
+                    stream->writeInput();
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    stream->readShell();
+            }
+            touched.append(stream);
+        }
+
+        // Output is passed on right away, waiting for the terminal's PTY
+        // only if it is full.
+        for (const QSharedPointer<PtyStream> &stream : qAsConst(touched)) {
+            if (stream->removed)
+                continue;
+            stream->writeOutput();
+            stream->updateEvents(m_epoll);
+            if (stream->shellClosed && stream->buffered == 0 && !stream->finishReported) {
+                stream->finishReported = true;
+                emit shellFinished(stream->id);
+            }
+        }
+    }
+#endif
+}
+
+} // namespace Internal
+} // namespace Terminal
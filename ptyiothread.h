@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef PTYIOTHREAD_H
+#define PTYIOTHREAD_H
+
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+class PtyStream;
+
+/*! The shell of a terminal whose PTY is served by the PtyIoThread.
+
+    The shell runs on a PTY of its own. The I/O thread reads that PTY into a
+    buffer and writes the buffer on to the terminal's PTY, which has no
+    process of its own (QTermWidget::startTerminalTeletype()). Keystrokes
+    go the other way. A stalled GUI thread then only fills the buffer, the
+    shell keeps running until the buffer is full.
+
+    The channel is a child of the terminal, use forTerminal() to find it.
+*/
+class PtyChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~PtyChannel();
+
+    static PtyChannel *forTerminal(QTermWidget *terminal);
+
+    /* Starts the terminal's shell like QTermWidget::startShellProgram(),
+       through the I/O thread if that is enabled and available. An empty
+       program is the user's shell. */
+    static void startShellProgram(QTermWidget *terminal, const QStringList &environment,
+                                  const QString &program = QString(),
+                                  const QStringList &arguments = QStringList());
+
+    // The QTermWidget functions only know about the terminal's own PTY.
+    static int shellPid(QTermWidget *terminal);
+    static QString workingDirectory(QTermWidget *terminal);
+
+    int shellPid() const;
+    qint64 bufferedBytes() const;
+    // Input that the shell has not read yet, see PasteStreamer.
+    qint64 queuedInput() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    PtyChannel(QTermWidget *terminal, const QSharedPointer<PtyStream> &stream);
+
+    static PtyChannel *start(QTermWidget *terminal, const QStringList &environment,
+                             const QString &program, const QStringList &arguments);
+    void sendInput(const char *data, int size);
+    void updateWindowSize();
+
+    QPointer<QTermWidget> m_terminal;
+    QSharedPointer<PtyStream> m_stream;
+};
+
+/*! One thread that moves the data of all PtyChannels, with epoll.
+
+    Per channel, at most maxBufferedBytes of output are buffered, in chunks
+    that the shell's PTY is read into and the terminal's PTY is written
+    from. Nothing else copies the data. Only implemented on Linux, the
+    "ptyIoThread" setting enables it for new terminals.
+
+    The plugin owns the only instance, use instance() to get it. The thread
+    itself is started with the first channel.
+*/
+class PtyIoThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit PtyIoThread(QObject *parent = nullptr);
+    ~PtyIoThread();
+
+    static PtyIoThread *instance();
+    static bool isAvailable();
+
+    static const int maxBufferedBytes = 16 * 1024 * 1024;
+
+    void add(const QSharedPointer<PtyStream> &stream);
+    void remove(const QSharedPointer<PtyStream> &stream);
+    void inputQueued(const QSharedPointer<PtyStream> &stream);
+
+signals:
+    // Emitted from the I/O thread once the shell's output has been written.
+    void shellFinished(quint64 streamId);
+
+protected:
+    void run() override;
+
+private:
+    void wake();
+
+    int m_epoll;
+    int m_wakeUp;
+    QMutex m_mutex;
+    QVector<QSharedPointer<PtyStream>> m_added;
+    QVector<QSharedPointer<PtyStream>> m_removed;
+    QVector<QSharedPointer<PtyStream>> m_inputQueued;
+    bool m_quit;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // PTYIOTHREAD_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "renderthrottle.h"
+
+#include <QLoggingCategory>
+#include <QTimer>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(renderLog, "qtc.terminal.render", QtWarningMsg)
+
+// Length of the window the output rate is measured over.
+static const int rateWindowMs = 250;
+
+RenderThrottle::RenderThrottle(QTermWidget *terminal)
+    : QObject(terminal)
+    , m_terminal(terminal)
+    , m_frameTimer(new QTimer(this))
+    , m_windowBytes(0)
+    , m_floodThreshold(4 * 1024 * 1024)
+    , m_skippedFrames(0)
+    , m_pendingChunks(0)
+    , m_suspended(false)
+    , m_flooding(false)
+{
+    setFloodFrameRate(30);
+    connect(m_frameTimer, &QTimer::timeout, this, &RenderThrottle::paintFrame);
+    connect(terminal, &QTermWidget::receivedData, this, &RenderThrottle::dataReceived);
+}
+
+RenderThrottle *RenderThrottle::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<RenderThrottle *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void RenderThrottle::setSuspended(bool suspended)
+{
+    if (m_suspended == suspended)
+        return;
+
+    m_suspended = suspended;
+    updateUpdatesEnabled();
+
+    // A flooding terminal keeps updates disabled, so bring it up to date
+    // right away instead of waiting for the next frame.
+    if (!suspended && m_flooding)
+        flushFrame();
+}
+
+bool RenderThrottle::isSuspended() const
+{
+    return m_suspended;
+}
+
+void RenderThrottle::setFloodThreshold(qint64 bytesPerSecond)
+{
+    m_floodThreshold = bytesPerSecond;
+}
+
+void RenderThrottle::setFloodFrameRate(int framesPerSecond)
+{
+    m_frameTimer->setInterval(1000 / qBound(1, framesPerSecond, 120));
+}
+
+bool RenderThrottle::isFlooding() const
+{
+    return m_flooding;
+}
+
+qint64 RenderThrottle::skippedFrames() const
+{
+    return m_skippedFrames;
+}
+
+void RenderThrottle::dataReceived(const QString &data)
+{
+    if (!m_rateWindow.isValid())
+        m_rateWindow.start();
+
+    m_windowBytes += data.size();
+    if (m_flooding)
+        ++m_pendingChunks;
+
+    if (m_rateWindow.elapsed() >= rateWindowMs)
+        updateRate();
+}
+
+void RenderThrottle::updateRate()
+{
+    const qint64 elapsed = qMax<qint64>(1, m_rateWindow.restart());
+    const qint64 rate = m_windowBytes * 1000 / elapsed;
+    m_windowBytes = 0;
+
+    if (m_floodThreshold <= 0)
+        setFlooding(false);
+    else if (!m_flooding && rate > m_floodThreshold)
+        setFlooding(true);
+    else if (m_flooding && rate < m_floodThreshold / 2)
+        setFlooding(false);
+}
+
+void RenderThrottle::paintFrame()
+{
+    // Once the output stops there is no new data to measure the rate with,
+    // so the frame timer also has to detect the end of a flood.
+    if (m_rateWindow.elapsed() >= rateWindowMs)
+        updateRate();
+
+    if (m_flooding)
+        flushFrame();
+}
+
+void RenderThrottle::flushFrame()
+{
+    if (m_pendingChunks == 0 || m_suspended)
+        return;
+
+    // Every chunk of output would have been at least one repaint without
+    // flood mode, only one of them is painted.
+    m_skippedFrames += m_pendingChunks - 1;
+    m_pendingChunks = 0;
+
+    m_terminal->setUpdatesEnabled(true);
+    m_terminal->repaint();
+    m_terminal->setUpdatesEnabled(false);
+}
+
+void RenderThrottle::setFlooding(bool flooding)
+{
+    if (m_flooding == flooding)
+        return;
+
+    if (flooding) {
+        m_pendingChunks = 0;
+        m_flooding = true;
+        m_frameTimer->start();
+    } else {
+        flushFrame();
+        m_flooding = false;
+        m_frameTimer->stop();
+        qCDebug(renderLog, "Leaving flood mode, %lld frames skipped so far",
+                m_skippedFrames);
+    }
+
+    updateUpdatesEnabled();
+    emit floodModeChanged(flooding);
+}
+
+void RenderThrottle::updateUpdatesEnabled()
+{
+    // Disabling updates propagates to the terminal display and its scroll
+    // bar, so repaints requested by new output are dropped right away.
+    // Enabling them again repaints the whole terminal once.
+    m_terminal->setUpdatesEnabled(!m_suspended && !m_flooding);
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef RENDERTHROTTLE_H
+#define RENDERTHROTTLE_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Controls when a terminal is allowed to repaint.
+
+    A suspended terminal keeps reading from its PTY and updating its screen
+    and history, but has widget updates disabled, so no paint or layout work
+    is done for it. Resuming it schedules a single full redraw.
+
+    When the terminal receives more output per second than the flood
+    threshold, it switches to flood mode: output is still parsed as fast as
+    it arrives, but the terminal is only repainted at the flood frame rate.
+    It switches back once the output rate drops below half the threshold.
+
+    The throttle is a child of the terminal it controls, use forTerminal() to
+    find it.
+*/
+class RenderThrottle : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderThrottle(QTermWidget *terminal);
+
+    static RenderThrottle *forTerminal(QTermWidget *terminal);
+
+    void setSuspended(bool suspended);
+    bool isSuspended() const;
+
+    void setFloodThreshold(qint64 bytesPerSecond);
+    void setFloodFrameRate(int framesPerSecond);
+    bool isFlooding() const;
+    qint64 skippedFrames() const;
+
+signals:
+    void floodModeChanged(bool flooding);
+
+private:
+    void dataReceived(const QString &data);
+    void updateRate();
+    void paintFrame();
+    void flushFrame();
+    void setFlooding(bool flooding);
+    void updateUpdatesEnabled();
+
+    QTermWidget *m_terminal;
+    QTimer *m_frameTimer;
+    QElapsedTimer m_rateWindow;
+    qint64 m_windowBytes;
+    qint64 m_floodThreshold;
+    qint64 m_skippedFrames;
+    int m_pendingChunks;
+    bool m_suspended;
+    bool m_flooding;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // RENDERTHROTTLE_H
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "scrollbackexport.h"
+
+#include <coreplugin/progressmanager/progressmanager.h>
+#include <utils/runextensions.h>
+
+#include <QSaveFile>
+
+namespace Terminal {
+namespace Internal {
+
+static const int writeBlockBytes = 1024 * 1024;
+static const int progressSteps = 1000;
+
+// Reports an error message, or an empty string on success.
+static void exportScrollback(QFutureInterface<QString> &futureInterface,
+                             const ScrollbackSnapshot &snapshot,
+                             const QString &fileName,
+                             ScrollbackExport::Format format)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        futureInterface.reportResult(file.errorString());
+        return;
+    }
+
+    futureInterface.setProgressRange(0, progressSteps);
+
+    const qint64 firstLine = snapshot.firstLine();
+    const qint64 lineCount = qMax<qint64>(snapshot.lineCount(), 1);
+    QByteArray block;
+    block.reserve(writeBlockBytes + 4096);
+    QString error;
+
+    const bool complete = snapshot.forEachLine([&](qint64 line, const QByteArray &rawLine) {
+        if (futureInterface.isCanceled())
+            return false;
+
+        if (format == ScrollbackExport::PlainText)
+            block += ScrollbackStore::plainText(rawLine).toUtf8();
+        else
+            block += rawLine;
+        block += '\n';
+
+        if (block.size() >= writeBlockBytes) {
+            if (file.write(block) != block.size()) {
+                error = file.errorString();
+                return false;
+            }
+            block.clear();
+            futureInterface.setProgressValue(int((line - firstLine) * progressSteps / lineCount));
+        }
+        return true;
+    });
+
+    if (futureInterface.isCanceled()) {
+        file.cancelWriting();
+        return;
+    }
+
+    if (complete && file.write(block) != block.size())
+        error = file.errorString();
+    else if (!complete && error.isEmpty())
+        error = ScrollbackExport::tr("The history could not be read.");
+
+    if (error.isEmpty() && !file.commit())
+        error = file.errorString();
+    else if (!error.isEmpty())
+        file.cancelWriting();
+
+    futureInterface.reportResult(error);
+}
+
+ScrollbackExport::ScrollbackExport(const ScrollbackSnapshot &snapshot,
+                                   const QString &fileName,
+                                   Format format,
+                                   QObject *parent)
+    : QObject(parent)
+    , m_snapshot(snapshot)
+    , m_fileName(fileName)
+    , m_format(format)
+{
+    connect(&m_watcher, &QFutureWatcher<QString>::finished, this, [this] {
+        emit finished(!isCanceled() && errorString().isEmpty());
+    });
+}
+
+void ScrollbackExport::start(const QString &title)
+{
+    const QFuture<QString> future = Utils::runAsync(&exportScrollback, m_snapshot, m_fileName, m_format);
+    m_watcher.setFuture(future);
+    Core::ProgressManager::addTask(future, title, "Terminal.ExportScrollback");
+}
+
+QString ScrollbackExport::fileName() const
+{
+    return m_fileName;
+}
+
+bool ScrollbackExport::isCanceled() const
+{
+    return m_watcher.isCanceled();
+}
+
+QString ScrollbackExport::errorString() const
+{
+    if (m_watcher.isCanceled() || m_watcher.future().resultCount() == 0)
+        return QString();
+    return m_watcher.result();
+}
+
+} // namespace Internal
+} // namespace Terminal
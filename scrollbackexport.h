@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef SCROLLBACKEXPORT_H
+#define SCROLLBACKEXPORT_H
+
+#include "scrollbackstore.h"
+
+#include <QFutureWatcher>
+#include <QObject>
+
+namespace Terminal {
+namespace Internal {
+
+/*! Writes the history of a terminal to a file.
+
+    The lines are read from a snapshot of the scrollback store on a worker
+    thread and written out in blocks, so neither the history nor the file
+    is ever held in memory as a whole. The export shows up in the progress
+    bar of Qt Creator, where it can be canceled. A canceled or failed export
+    leaves no file behind.
+*/
+class ScrollbackExport : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        PlainText,          // Escape sequences are stripped
+        EscapeSequences     // Lines as received, including colors
+    };
+
+    ScrollbackExport(const ScrollbackSnapshot &snapshot,
+                     const QString &fileName,
+                     Format format,
+                     QObject *parent = nullptr);
+
+    void start(const QString &title);
+
+    QString fileName() const;
+    bool isCanceled() const;
+    QString errorString() const;
+
+signals:
+    void finished(bool success);
+
+private:
+    ScrollbackSnapshot m_snapshot;
+    QString m_fileName;
+    Format m_format;
+    QFutureWatcher<QString> m_watcher;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // SCROLLBACKEXPORT_H
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "scrollbacksearch.h"
+#include "scrollbackstore.h"
+
+namespace Terminal {
+namespace Internal {
+
+// How many lines are scanned between two checks for cancellation.
+static const int cancelCheckInterval = 4096;
+
+// plainText() drops or interprets DEL and every control character but the
+// tab, any of them may split a match in the raw line.
+static bool needsDecoding(const QByteArray &rawLine)
+{
+    for (const char c : rawLine) {
+        if ((uchar(c) < 0x20 && c != '\t') || uchar(c) == 0x7f)
+            return true;
+    }
+    return false;
+}
+
+ScrollbackSearch::ScrollbackSearch(const QString &pattern, Core::FindFlags flags)
+    : m_pattern(pattern)
+    , m_flags(flags)
+    , m_rawPrefilter(false)
+{
+    const Qt::CaseSensitivity caseSensitivity = (flags & Core::FindCaseSensitively)
+            ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    if (flags & Core::FindRegularExpression) {
+        QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+        if (caseSensitivity == Qt::CaseInsensitive)
+            options |= QRegularExpression::CaseInsensitiveOption;
+        m_regexp = QRegularExpression(pattern, options);
+        m_regexp.optimize();
+        return;
+    }
+
+    m_matcher = QStringMatcher(pattern, caseSensitivity);
+
+    // The raw bytes can only rule a line out if they are compared exactly.
+    if (caseSensitivity == Qt::CaseSensitive) {
+        m_rawMatcher = QByteArrayMatcher(pattern.toUtf8());
+        m_rawPrefilter = true;
+    }
+}
+
+bool ScrollbackSearch::isValid() const
+{
+    if (m_pattern.isEmpty())
+        return false;
+    if (m_flags & Core::FindRegularExpression)
+        return m_regexp.isValid();
+    return true;
+}
+
+QString ScrollbackSearch::pattern() const
+{
+    return m_pattern;
+}
+
+Core::FindFlags ScrollbackSearch::flags() const
+{
+    return m_flags;
+}
+
+void ScrollbackSearch::matchLine(qint64 line, const QByteArray &rawLine,
+                                 QVector<ScrollbackMatch> &matches) const
+{
+    if (m_rawPrefilter && m_rawMatcher.indexIn(rawLine) < 0 && !needsDecoding(rawLine))
+        return;
+
+    const QString text = ScrollbackStore::plainText(rawLine);
+
+    if (m_flags & Core::FindRegularExpression) {
+        QRegularExpressionMatchIterator it = m_regexp.globalMatch(text);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            if (match.capturedLength() > 0)
+                matches.append({line, match.capturedStart(), match.capturedLength()});
+        }
+        return;
+    }
+
+    const int length = m_pattern.size();
+    for (int pos = m_matcher.indexIn(text); pos >= 0; pos = m_matcher.indexIn(text, pos + length))
+        matches.append({line, pos, length});
+}
+
+QVector<ScrollbackMatch> ScrollbackSearch::search(const ScrollbackSnapshot &snapshot,
+                                                  qint64 from,
+                                                  qint64 to,
+                                                  const std::function<bool()> &isCanceled) const
+{
+    QVector<ScrollbackMatch> matches;
+    if (!isValid())
+        return matches;
+
+    int scanned = 0;
+    snapshot.forEachLine(from, to, [&](qint64 line, const QByteArray &rawLine) {
+        if (isCanceled && ++scanned % cancelCheckInterval == 0 && isCanceled())
+            return false;
+        matchLine(line, rawLine, matches);
+        return true;
+    });
+
+    return matches;
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef SCROLLBACKSEARCH_H
+#define SCROLLBACKSEARCH_H
+
+#include <coreplugin/find/textfindconstants.h>
+
+#include <QByteArrayMatcher>
+#include <QRegularExpression>
+#include <QStringMatcher>
+#include <QVector>
+
+#include <functional>
+
+namespace Terminal {
+namespace Internal {
+
+class ScrollbackSnapshot;
+
+struct ScrollbackMatch
+{
+    qint64 line;
+    int column;
+    int length;
+};
+
+/*! One search query over the output history of a terminal.
+
+    The query is prepared once: plain text gets a Boyer-Moore matcher, and a
+    regular expression is compiled and optimized in the constructor. Lines
+    without escape sequences are first checked on their raw bytes, so most
+    lines that cannot match are never decoded.
+
+    A ScrollbackSearch is immutable after construction and may be used from
+    several threads at once.
+*/
+class ScrollbackSearch
+{
+public:
+    ScrollbackSearch(const QString &pattern, Core::FindFlags flags);
+
+    bool isValid() const;
+    QString pattern() const;
+    Core::FindFlags flags() const;
+
+    void matchLine(qint64 line, const QByteArray &rawLine,
+                   QVector<ScrollbackMatch> &matches) const;
+
+    QVector<ScrollbackMatch> search(const ScrollbackSnapshot &snapshot,
+                                    qint64 from,
+                                    qint64 to,
+                                    const std::function<bool()> &isCanceled = {}) const;
+
+private:
+    QString m_pattern;
+    Core::FindFlags m_flags;
+    QRegularExpression m_regexp;
+    QStringMatcher m_matcher;
+    QByteArrayMatcher m_rawMatcher;
+    bool m_rawPrefilter;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // SCROLLBACKSEARCH_H
@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "scrollbackstore.h"
+
+#include <QDir>
+#include <QLoggingCategory>
+#include <QTemporaryFile>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(scrollbackLog, "qtc.terminal.scrollback", QtWarningMsg)
+
+// Raw bytes of output that go into one compressed block. Up to two blocks
+// worth of lines are kept in memory before the oldest block is spilled.
+static const int blockBytes = 256 * 1024;
+
+// A line that never ends (e.g. a progress bar redrawn with \r) is cut here.
+static const int maxLineBytes = 1024 * 1024;
+
+// Rewrite the temporary file once more than this much of it is unused.
+static const qint64 compactThreshold = 4 * 1024 * 1024;
+
+// Rough per-line overhead of a QByteArray in the in-memory tail.
+static const int lineOverhead = 32;
+
+static qint64 s_totalBudget = 1024LL * 1024 * 1024;
+
+static QVector<ScrollbackStore *> &stores()
+{
+    static QVector<ScrollbackStore *> allStores;
+    return allStores;
+}
+
+/*! Temporary file holding the compressed blocks of a store. It is shared
+    between the store and its snapshots, and removed once the last of them
+    lets go of it.
+*/
+class ScrollbackFile
+{
+public:
+    explicit ScrollbackFile(const QString &path) : m_path(path) {}
+    ~ScrollbackFile() { QFile::remove(m_path); }
+
+    QString path() const { return m_path; }
+
+private:
+    QString m_path;
+};
+
+qint64 ScrollbackSnapshot::firstLine() const
+{
+    return m_firstLine;
+}
+
+qint64 ScrollbackSnapshot::endLine() const
+{
+    return m_tailFirstLine + m_tail.count();
+}
+
+qint64 ScrollbackSnapshot::lineCount() const
+{
+    return endLine() - m_firstLine;
+}
+
+bool ScrollbackSnapshot::endsWithPartialLine() const
+{
+    return m_partialLine;
+}
+
+bool ScrollbackSnapshot::forEachLine(const LineVisitor &visitor) const
+{
+    return forEachLine(firstLine(), endLine(), visitor);
+}
+
+bool ScrollbackSnapshot::forEachLine(qint64 from, qint64 to, const LineVisitor &visitor) const
+{
+    from = qMax(from, m_firstLine);
+    to = qMin(to, endLine());
+
+    QFile reader;
+    for (const Block &block : m_blocks) {
+        if (from >= to)
+            return true;
+        if (block.firstLine + block.lineCount <= from)
+            continue;
+
+        if (!reader.isOpen()) {
+            reader.setFileName(m_file->path());
+            if (!reader.open(QIODevice::ReadOnly))
+                return false;
+        }
+
+        uchar *mapped = reader.map(block.offset, block.compressedSize);
+        if (!mapped)
+            return false;
+        const QByteArray raw = qUncompress(mapped, block.compressedSize);
+        reader.unmap(mapped);
+
+        // Lines are handed out as views into the decompressed block.
+        qint64 line = block.firstLine;
+        const char *begin = raw.constData();
+        const char *end = begin + raw.size();
+        while (line < to) {
+            const char *newline = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+            const char *lineEnd = newline ? newline : end;
+            if (line >= from) {
+                if (!visitor(line, QByteArray::fromRawData(begin, int(lineEnd - begin))))
+                    return false;
+            }
+            ++line;
+            if (!newline)
+                break;
+            begin = newline + 1;
+        }
+        from = line;
+    }
+
+    for (qint64 line = qMax(from, m_tailFirstLine); line < to; ++line) {
+        if (!visitor(line, m_tail.at(int(line - m_tailFirstLine))))
+            return false;
+    }
+
+    return true;
+}
+
+ScrollbackStore::ScrollbackStore(QTermWidget *terminal)
+    : QObject(terminal)
+    , m_tailFirstLine(0)
+    , m_tailBytes(0)
+    , m_diskBytes(0)
+    , m_budget(64 * 1024 * 1024)
+{
+    stores().append(this);
+
+    connect(terminal, &QTermWidget::receivedData, this, [this](const QString &data) {
+        // receivedData() hands out the raw PTY bytes as Latin-1.
+        append(data.toLatin1());
+    });
+}
+
+ScrollbackStore::~ScrollbackStore()
+{
+    stores().removeOne(this);
+}
+
+ScrollbackStore *ScrollbackStore::forTerminal(QTermWidget *terminal)
+{
+    if (!terminal)
+        return nullptr;
+    return terminal->findChild<ScrollbackStore *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void ScrollbackStore::setTotalBudget(qint64 bytes)
+{
+    s_totalBudget = bytes;
+    enforceTotalBudget();
+}
+
+qint64 ScrollbackStore::totalBytes()
+{
+    qint64 total = 0;
+    for (const ScrollbackStore *store : qAsConst(stores()))
+        total += store->memoryBytes() + store->diskBytes();
+    return total;
+}
+
+void ScrollbackStore::setBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    enforceBudget();
+}
+
+qint64 ScrollbackStore::firstLine() const
+{
+    return m_blocks.isEmpty() ? m_tailFirstLine : m_blocks.first().firstLine;
+}
+
+qint64 ScrollbackStore::endLine() const
+{
+    return m_tailFirstLine + m_tail.count();
+}
+
+qint64 ScrollbackStore::lineCount() const
+{
+    return endLine() - firstLine();
+}
+
+qint64 ScrollbackStore::memoryBytes() const
+{
+    return m_tailBytes + m_partial.size() + m_tail.count() * lineOverhead;
+}
+
+qint64 ScrollbackStore::diskBytes() const
+{
+    return m_diskBytes;
+}
+
+ScrollbackSnapshot ScrollbackStore::snapshot() const
+{
+    ScrollbackSnapshot snapshot;
+    snapshot.m_file = m_file;
+    snapshot.m_blocks = m_blocks;
+    snapshot.m_tail = m_tail;
+    snapshot.m_tailFirstLine = m_tailFirstLine;
+    snapshot.m_firstLine = firstLine();
+
+    // The line the cursor is on is part of the snapshot, even though it is
+    // not finished yet.
+    if (!m_partial.isEmpty()) {
+        snapshot.m_tail.append(m_partial);
+        snapshot.m_partialLine = true;
+    }
+
+    return snapshot;
+}
+
+void ScrollbackStore::append(const QByteArray &data)
+{
+    const char *begin = data.constData();
+    const char *end = begin + data.size();
+
+    while (begin < end) {
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        if (newline) {
+            m_partial.append(begin, int(newline - begin));
+            begin = newline + 1;
+        } else {
+            m_partial.append(begin, int(end - begin));
+            begin = end;
+            if (m_partial.size() < maxLineBytes)
+                break;
+        }
+
+        if (m_partial.endsWith('\r'))
+            m_partial.chop(1);
+        m_tailBytes += m_partial.size();
+        m_tail.append(m_partial);
+        m_partial.clear();
+    }
+
+    if (m_tailBytes < 2 * blockBytes)
+        return;
+
+    int count = 0;
+    qint64 bytes = 0;
+    while (count < m_tail.count() && bytes < blockBytes)
+        bytes += m_tail.at(count++).size();
+    spill(count);
+}
+
+void ScrollbackStore::flush()
+{
+    if (!m_tail.isEmpty())
+        spill(m_tail.count());
+    m_tail.squeeze();
+}
+
+void ScrollbackStore::spill(int lineCount)
+{
+    QByteArray raw;
+    qint64 rawBytes = 0;
+    for (int i = 0; i < lineCount; ++i)
+        rawBytes += m_tail.at(i).size() + 1;
+    raw.reserve(int(rawBytes));
+    for (int i = 0; i < lineCount; ++i) {
+        if (i)
+            raw.append('\n');
+        raw.append(m_tail.at(i));
+    }
+
+    if (openFile()) {
+        const QByteArray compressed = qCompress(raw, 1);
+        const qint64 offset = m_writer.size();
+        if (m_writer.write(compressed) == compressed.size() && m_writer.flush()) {
+            m_blocks.append({offset, compressed.size(), m_tailFirstLine, lineCount});
+            m_diskBytes += compressed.size();
+        } else {
+            // Without a place to put them, the oldest lines are simply lost.
+            qCWarning(scrollbackLog, "Cannot write scrollback to %s: %s",
+                      qPrintable(m_writer.fileName()), qPrintable(m_writer.errorString()));
+        }
+    }
+
+    m_tail.remove(0, lineCount);
+    m_tailFirstLine += lineCount;
+    m_tailBytes -= rawBytes - lineCount;
+
+    enforceBudget();
+    enforceTotalBudget();
+}
+
+bool ScrollbackStore::openFile()
+{
+    if (m_writer.isOpen())
+        return true;
+
+    QTemporaryFile file(QDir::tempPath() + "/qtc-terminal-XXXXXX.scrollback");
+    file.setAutoRemove(false);
+    if (!file.open()) {
+        qCWarning(scrollbackLog, "Cannot create scrollback file: %s",
+                  qPrintable(file.errorString()));
+        return false;
+    }
+
+    m_file.reset(new ScrollbackFile(file.fileName()));
+    m_writer.setFileName(file.fileName());
+    return m_writer.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void ScrollbackStore::dropOldestBlock()
+{
+    m_diskBytes -= m_blocks.first().compressedSize;
+    m_blocks.removeFirst();
+
+    if (m_blocks.isEmpty()) {
+        // Start over with a fresh file, snapshots keep the old one alive.
+        m_writer.close();
+        m_file.reset();
+    } else if (m_blocks.first().offset > qMax(m_diskBytes, compactThreshold)) {
+        compact();
+    }
+}
+
+void ScrollbackStore::compact()
+{
+    QSharedPointer<ScrollbackFile> oldFile = m_file;
+    QVector<ScrollbackSnapshot::Block> blocks = m_blocks;
+
+    QFile reader(oldFile->path());
+    m_writer.close();
+    m_file.reset();
+
+    if (!reader.open(QIODevice::ReadOnly) || !openFile()) {
+        m_blocks.clear();
+        m_diskBytes = 0;
+        return;
+    }
+
+    for (ScrollbackSnapshot::Block &block : blocks) {
+        uchar *mapped = reader.map(block.offset, block.compressedSize);
+        if (!mapped)
+            break;
+        block.offset = m_writer.size();
+        m_writer.write(reinterpret_cast<const char *>(mapped), block.compressedSize);
+        reader.unmap(mapped);
+    }
+    m_writer.flush();
+
+    m_blocks = blocks;
+}
+
+void ScrollbackStore::enforceBudget()
+{
+    while (!m_blocks.isEmpty() && m_diskBytes + memoryBytes() > m_budget)
+        dropOldestBlock();
+}
+
+void ScrollbackStore::enforceTotalBudget()
+{
+    qint64 total = totalBytes();
+
+    while (total > s_totalBudget) {
+        auto largest = std::max_element(stores().begin(), stores().end(),
+                                        [](const ScrollbackStore *a, const ScrollbackStore *b) {
+            return a->diskBytes() < b->diskBytes();
+        });
+        if (largest == stores().end() || (*largest)->m_blocks.isEmpty())
+            return;
+
+        const qint64 before = (*largest)->diskBytes();
+        (*largest)->dropOldestBlock();
+        total -= before - (*largest)->diskBytes();
+    }
+}
+
+QString ScrollbackStore::plainText(const QByteArray &rawLine)
+{
+    QByteArray text;
+    text.reserve(rawLine.size());
+
+    const int size = rawLine.size();
+    for (int i = 0; i < size; ++i) {
+        const uchar c = uchar(rawLine.at(i));
+
+        if (c == 0x1b) {
+            if (i + 1 >= size)
+                break;
+            const char kind = rawLine.at(i + 1);
+            if (kind == '[') {
+                // CSI: parameter and intermediate bytes up to the final byte.
+                i += 2;
+                while (i < size && (uchar(rawLine.at(i)) < 0x40 || uchar(rawLine.at(i)) > 0x7e))
+                    ++i;
+            } else if (kind == ']' || kind == 'P' || kind == '_' || kind == '^') {
+                // OSC, DCS, APC and PM strings end with BEL or ST.
+                i += 2;
+                while (i < size && rawLine.at(i) != '\a'
+                       && !(rawLine.at(i) == '\x1b' && i + 1 < size && rawLine.at(i + 1) == '\\')) {
+                    ++i;
+                }
+                if (i < size && rawLine.at(i) == '\x1b')
+                    ++i;
+            } else if (kind == '(' || kind == ')' || kind == '*' || kind == '+' || kind == '#') {
+                i += 2;
+            } else {
+                i += 1;
+            }
+        } else if (c == '\r') {
+            // Whatever follows is written over the start of the line.
+            text.clear();
+        } else if (c == '\b') {
+            if (!text.isEmpty())
+                text.chop(1);
+        } else if (c == '\t' || (c >= 0x20 && c != 0x7f)) {
+            text.append(char(c));
+        }
+    }
+
+    return QString::fromUtf8(text);
+}
+
+} // namespace Internal
+} // namespace Terminal
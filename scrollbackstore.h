@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef SCROLLBACKSTORE_H
+#define SCROLLBACKSTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+class ScrollbackFile;
+
+/*! Read-only view of a ScrollbackStore at one point in time.
+
+    A snapshot is cheap to take and may be read from any thread, the store
+    keeps appending lines and dropping old ones independently of it.
+*/
+class ScrollbackSnapshot
+{
+public:
+    using LineVisitor = std::function<bool(qint64 line, const QByteArray &rawLine)>;
+
+    qint64 firstLine() const;
+    qint64 endLine() const;
+    qint64 lineCount() const;
+    bool endsWithPartialLine() const;
+
+    // Calls visitor for every line in [from, to) until it returns false.
+    // Returns false if the visitor stopped early or reading failed.
+    bool forEachLine(qint64 from, qint64 to, const LineVisitor &visitor) const;
+    bool forEachLine(const LineVisitor &visitor) const;
+
+private:
+    friend class ScrollbackStore;
+
+    struct Block
+    {
+        qint64 offset;
+        int compressedSize;
+        qint64 firstLine;
+        int lineCount;
+    };
+
+    QSharedPointer<ScrollbackFile> m_file;
+    QVector<Block> m_blocks;
+    QVector<QByteArray> m_tail;
+    qint64 m_tailFirstLine = 0;
+    qint64 m_firstLine = 0;
+    bool m_partialLine = false;
+};
+
+/*! Keeps the full output history of one terminal.
+
+    The most recent lines are kept in memory. Older lines are spilled in
+    blocks, compressed, to a temporary file that is memory-mapped for
+    reading. Every store has its own byte budget, and all stores share a
+    total budget. When a budget is exceeded, the oldest blocks are dropped.
+
+    Lines are stored as the raw bytes received from the PTY, including
+    escape sequences. plainText() turns them into displayable text.
+
+    The store is a child of the terminal it records, use forTerminal() to
+    find it.
+*/
+class ScrollbackStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScrollbackStore(QTermWidget *terminal);
+    ~ScrollbackStore();
+
+    static ScrollbackStore *forTerminal(QTermWidget *terminal);
+
+    static void setTotalBudget(qint64 bytes);
+    static qint64 totalBytes();
+    void setBudget(qint64 bytes);
+
+    qint64 firstLine() const;
+    qint64 endLine() const;
+    qint64 lineCount() const;
+    qint64 memoryBytes() const;
+    qint64 diskBytes() const;
+
+    ScrollbackSnapshot snapshot() const;
+    void append(const QByteArray &data);
+    void flush();
+
+    static QString plainText(const QByteArray &rawLine);
+
+private:
+    void spill(int lineCount);
+    bool openFile();
+    void dropOldestBlock();
+    void compact();
+    void enforceBudget();
+    static void enforceTotalBudget();
+
+    QSharedPointer<ScrollbackFile> m_file;
+    QFile m_writer;
+    QVector<ScrollbackSnapshot::Block> m_blocks;
+    QVector<QByteArray> m_tail;
+    QByteArray m_partial;
+    qint64 m_tailFirstLine;
+    qint64 m_tailBytes;
+    qint64 m_diskBytes;
+    qint64 m_budget;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // SCROLLBACKSTORE_H
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "shellpool.h"
+
+#include <QDir>
+#include <QLoggingCategory>
+#include <QTimer>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(poolLog, "qtc.terminal.pool", QtWarningMsg)
+
+// Delay between starting two pooled shells, so that refilling the pool does
+// not compete with whatever the user is doing in the new terminal.
+static const int refillDelayMs = 1000;
+// Shells that end before printing anything are not started again after
+// this many attempts in a row.
+static const int maxFailedStarts = 3;
+
+ShellPool::ShellPool(const Factory &factory, const Signature &signature, QObject *parent)
+    : QObject(parent)
+    , m_factory(factory)
+    , m_signature(signature)
+    , m_workingDirectory(QDir::homePath())
+    , m_refillTimer(new QTimer(this))
+    , m_size(0)
+    , m_failedStarts(0)
+{
+    m_refillTimer->setSingleShot(true);
+    m_refillTimer->setInterval(refillDelayMs);
+    connect(m_refillTimer, &QTimer::timeout, this, &ShellPool::refill);
+}
+
+ShellPool::~ShellPool()
+{
+    clear();
+}
+
+void ShellPool::setSize(int size)
+{
+    m_size = qMax(0, size);
+    m_failedStarts = 0;
+
+    while (m_entries.count() > m_size)
+        remove(m_entries.last().widget);
+
+    scheduleRefill();
+}
+
+int ShellPool::size() const
+{
+    return m_size;
+}
+
+QTermWidget *ShellPool::take(const QString &workingDirectory)
+{
+    // Shells for another directory would have to be told to change it,
+    // the pool follows the directory instead.
+    m_workingDirectory = QDir::cleanPath(workingDirectory);
+    dropStale(m_signature());
+
+    if (m_entries.isEmpty()) {
+        scheduleRefill();
+        return nullptr;
+    }
+
+    // Prefer a shell that already printed its prompt, but a shell that is
+    // still starting up is better than starting a new one from scratch.
+    int index = 0;
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries.at(i).ready) {
+            index = i;
+            break;
+        }
+    }
+
+    QTermWidget *widget = m_entries.takeAt(index).widget;
+    disconnect(widget, nullptr, this, nullptr);
+    scheduleRefill();
+
+    return widget;
+}
+
+void ShellPool::scheduleRefill()
+{
+    if (m_entries.count() < m_size && m_failedStarts < maxFailedStarts && !m_refillTimer->isActive())
+        m_refillTimer->start();
+}
+
+void ShellPool::clear()
+{
+    m_refillTimer->stop();
+
+    for (const Entry &entry : qAsConst(m_entries)) {
+        if (entry.widget)
+            entry.widget->deleteLater();
+    }
+    m_entries.clear();
+}
+
+void ShellPool::refill()
+{
+    const QByteArray signature = m_signature();
+    dropStale(signature);
+
+    if (m_entries.count() >= m_size)
+        return;
+
+    QTermWidget *widget = m_factory(m_workingDirectory);
+    widget->hide();
+    m_entries.append({widget, signature, m_workingDirectory, false});
+
+    connect(widget, &QTermWidget::receivedData, this, [this, widget] {
+        for (Entry &entry : m_entries) {
+            if (entry.widget == widget)
+                entry.ready = true;
+        }
+        m_failedStarts = 0;
+    });
+
+    connect(widget, &QTermWidget::finished, this, [this, widget] {
+        bool ready = false;
+        for (const Entry &entry : qAsConst(m_entries)) {
+            if (entry.widget == widget)
+                ready = entry.ready;
+        }
+        remove(widget);
+
+        if (!ready && ++m_failedStarts == maxFailedStarts) {
+            qCWarning(poolLog, "The shell ended %d times without any output, "
+                      "no more shells are started in advance", maxFailedStarts);
+        }
+        scheduleRefill();
+    });
+
+    // Start one shell per round, the next one follows after the delay.
+    scheduleRefill();
+}
+
+void ShellPool::dropStale(const QByteArray &signature)
+{
+    for (int i = m_entries.count() - 1; i >= 0; --i) {
+        const Entry entry = m_entries.at(i);
+        if (entry.widget && entry.signature == signature
+                && entry.workingDirectory == m_workingDirectory) {
+            continue;
+        }
+
+        m_entries.removeAt(i);
+        if (entry.widget) {
+            disconnect(entry.widget, nullptr, this, nullptr);
+            entry.widget->deleteLater();
+        }
+    }
+}
+
+void ShellPool::remove(QTermWidget *widget)
+{
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries.at(i).widget == widget) {
+            m_entries.removeAt(i);
+            break;
+        }
+    }
+
+    if (widget) {
+        disconnect(widget, nullptr, this, nullptr);
+        widget->deleteLater();
+    }
+}
+
+} // namespace Internal
+} // namespace Terminal
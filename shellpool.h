@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef SHELLPOOL_H
+#define SHELLPOOL_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace Terminal {
+namespace Internal {
+
+/*! Keeps a number of hidden terminals whose shell has already been started,
+    so that a new terminal does not have to wait for the shell's startup
+    files.
+
+    Every pooled terminal remembers the signature (environment, font, color
+    scheme) it has been created with. Terminals whose signature no longer
+    matches the current one are recycled instead of being handed out.
+
+    Pooled shells are started in the working directory of the last request,
+    a pooled terminal is only handed out for that same directory. Nothing is
+    ever typed into a pooled shell.
+*/
+class ShellPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Factory = std::function<QTermWidget *(const QString &workingDirectory)>;
+    using Signature = std::function<QByteArray()>;
+
+    ShellPool(const Factory &factory, const Signature &signature, QObject *parent = nullptr);
+    ~ShellPool();
+
+    void setSize(int size);
+    int size() const;
+
+    // Returns nullptr if no shell has been started in workingDirectory.
+    QTermWidget *take(const QString &workingDirectory);
+    void scheduleRefill();
+    void clear();
+
+private:
+    struct Entry
+    {
+        QPointer<QTermWidget> widget;
+        QByteArray signature;
+        QString workingDirectory;
+        bool ready;
+    };
+
+    void refill();
+    void dropStale(const QByteArray &signature);
+    void remove(QTermWidget *widget);
+
+    Factory m_factory;
+    Signature m_signature;
+    QList<Entry> m_entries;
+    QString m_workingDirectory;
+    QTimer *m_refillTimer;
+    int m_size;
+    int m_failedStarts;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // SHELLPOOL_H
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "startuptiming.h"
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(startupLog, "qtc.terminal.startup", QtWarningMsg)
+
+namespace StartupTiming {
+
+void mark(const char *phase)
+{
+    static QElapsedTimer timer;
+    static qint64 previous = 0;
+
+    if (!timer.isValid())
+        timer.start();
+
+    const qint64 now = timer.nsecsElapsed();
+    qCDebug(startupLog, "%s: %.3f ms since last mark, %.3f ms since plugin load",
+            phase, (now - previous) / 1e6, now / 1e6);
+    previous = now;
+}
+
+} // namespace StartupTiming
+
+} // namespace Internal
+} // namespace Terminal
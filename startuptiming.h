@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef STARTUPTIMING_H
+#define STARTUPTIMING_H
+
+namespace Terminal {
+namespace Internal {
+
+/*! Startup timing report of the plugin.
+
+    Every mark() logs the time since the previous mark and since the plugin
+    was loaded to the "qtc.terminal.startup" logging category. Enable it with
+    QT_LOGGING_RULES="qtc.terminal.startup.debug=true".
+*/
+namespace StartupTiming {
+
+void mark(const char *phase);
+
+} // namespace StartupTiming
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // STARTUPTIMING_H
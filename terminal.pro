@@ -2,11 +2,57 @@ DEFINES += TERMINALPLUGIN_LIBRARY
 
 HEADERS += terminalplugin.h \
            terminalwindow.h \
-           findsupport.h
+           colorschemecatalog.h \
+           diagnosticsparser.h \
+           findinterminals.h \
+           findsupport.h \
+           hibernator.h \
+           hotspotdetector.h \
+           latencyprobe.h \
+           outputlogger.h \
+           pastestreamer.h \
+           perfcounters.h \
+           projectfileindex.h \
+           ptyiothread.h \
+           renderthrottle.h \
+           scrollbackexport.h \
+           scrollbacksearch.h \
+           scrollbackstore.h \
+           shellpool.h \
+           startuptiming.h \
+           terminalbenchmark.h \
+           terminaldiagnostics.h \
+           terminalgeometry.h \
+           terminallistmodel.h \
+           terminalsession.h \
+           terminalsettings.h
 
 SOURCES += terminalplugin.cpp \
            terminalwindow.cpp \
-           findsupport.cpp
+           colorschemecatalog.cpp \
+           diagnosticsparser.cpp \
+           findinterminals.cpp \
+           findsupport.cpp \
+           hibernator.cpp \
+           hotspotdetector.cpp \
+           latencyprobe.cpp \
+           outputlogger.cpp \
+           pastestreamer.cpp \
+           perfcounters.cpp \
+           projectfileindex.cpp \
+           ptyiothread.cpp \
+           renderthrottle.cpp \
+           scrollbackexport.cpp \
+           scrollbacksearch.cpp \
+           scrollbackstore.cpp \
+           shellpool.cpp \
+           startuptiming.cpp \
+           terminalbenchmark.cpp \
+           terminaldiagnostics.cpp \
+           terminalgeometry.cpp \
+           terminallistmodel.cpp \
+           terminalsession.cpp \
+           terminalsettings.cpp
 
 ## set the QTC_SOURCE environment variable to override the setting here
 QTCREATOR_SOURCES = $$(QTC_SOURCE)
@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "terminalbenchmark.h"
+#include "latencyprobe.h"
+#include "renderthrottle.h"
+#include "scrollbacksearch.h"
+#include "scrollbackstore.h"
+#include "terminallistmodel.h"
+#include "terminalwindow.h"
+
+#include <QComboBox>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <QVector>
+
+#include <qtermwidget5/qtermwidget.h>
+
+#include <algorithm>
+
+namespace Terminal {
+namespace Internal {
+
+static const qint64 workloadBytes = 32 * 1024 * 1024;
+static const qint64 memoryWorkloadBytes = 4 * 1024 * 1024;
+static const int sampleCount = 10;
+static const int searchLines = 1000000;
+static const int timeoutMs = 120000;
+
+// Runs the event loop until condition() holds. Returns false on timeout.
+static bool waitFor(const std::function<bool()> &condition, int timeout = timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Makes sure WaitForMoreEvents comes back to check the condition.
+    QTimer tick;
+    tick.start(5);
+
+    while (!condition()) {
+        if (timer.hasExpired(timeout))
+            return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+static double milliseconds(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+static QJsonObject summarize(QVector<double> samples)
+{
+    QJsonArray values;
+    for (double sample : qAsConst(samples))
+        values.append(sample);
+
+    std::sort(samples.begin(), samples.end());
+    QJsonObject summary;
+    summary.insert("samples", values);
+    if (!samples.isEmpty()) {
+        summary.insert("min", samples.first());
+        summary.insert("median", samples.at(samples.size() / 2));
+        summary.insert("max", samples.last());
+    }
+    return summary;
+}
+
+// Resident set size in KiB, or -1 where /proc is not available.
+static qint64 residentKiB(const char *field)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly))
+        return -1;
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (line.startsWith(field))
+            return line.mid(int(qstrlen(field))).trimmed().split(' ').value(0).toLongLong();
+    }
+    return -1;
+}
+
+static QByteArray plainChunk(int i)
+{
+    return QString("%1: The quick brown fox jumps over the lazy dog, again and again and again.\n")
+            .arg(i, 8).toLatin1();
+}
+
+static QByteArray compilerChunk(int i)
+{
+    return QString("\x1b[1m/src/module%1/file%2.cpp:%3:17: \x1b[1;31merror: \x1b[0m"
+                   "\x1b[1muse of undeclared identifier 'value%3'\x1b[0m\n"
+                   "    return value%3 + 1;\n"
+                   "\x1b[1;32m           ^\x1b[0m\n")
+            .arg(i % 97).arg(i % 13).arg(i).toLatin1();
+}
+
+static QByteArray fullScreenChunk(int i)
+{
+    // One frame of a full-screen program: redraw all rows in place.
+    QByteArray frame = "\x1b[H";
+    for (int row = 1; row <= 24; ++row) {
+        frame += QString("\x1b[%1;1H\x1b[3%2m%3 row %4 %5\x1b[0m\x1b[K")
+                .arg(row).arg((row + i) % 8).arg(i, 8).arg(row, 2)
+                .arg(QString(56, QChar('a' + (i + row) % 26))).toLatin1();
+    }
+    return frame;
+}
+
+class PaintWatcher : public QObject
+{
+public:
+    explicit PaintWatcher(QWidget *widget)
+    {
+        widget->installEventFilter(this);
+        for (QWidget *child : widget->findChildren<QWidget *>())
+            child->installEventFilter(this);
+    }
+
+    bool painted = false;
+
+protected:
+    bool eventFilter(QObject *, QEvent *event) override
+    {
+        if (event->type() == QEvent::Paint)
+            painted = true;
+        return false;
+    }
+};
+
+TerminalBenchmark::TerminalBenchmark()
+    : m_host(new QWidget)
+    , m_markerCount(0)
+{
+    auto terminalsBox = new QComboBox(m_host);
+    terminalsBox->hide();
+    m_container = new TerminalContainer(m_host, terminalsBox);
+    m_container->setSessionEnabled(false);
+    terminalsBox->setModel(m_container->terminalList());
+
+    auto layout = new QVBoxLayout(m_host);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(m_container);
+    m_host->resize(1000, 600);
+}
+
+TerminalBenchmark::~TerminalBenchmark()
+{
+    delete m_host;
+}
+
+bool TerminalBenchmark::run(const QString &resultFile, QString *errorMessage)
+{
+    if (!m_workDir.isValid()) {
+        *errorMessage = QString("Cannot create a temporary directory: %1").arg(m_workDir.errorString());
+        return false;
+    }
+
+    m_host->show();
+    m_container->initialize();
+
+    QJsonObject benchmarks;
+    benchmarks.insert("throughput", measureThroughput());
+    benchmarks.insert("createTerminal", measureCreateTerminal());
+    benchmarks.insert("tabSwitch", measureTabSwitch());
+    benchmarks.insert("inputLatency", measureInputLatency());
+    benchmarks.insert("search", measureSearch());
+    benchmarks.insert("memory", measureMemory());
+
+    QJsonObject result;
+    result.insert("format", 1);
+    result.insert("date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    result.insert("qtVersion", QString::fromLatin1(qVersion()));
+    result.insert("platform", QGuiApplication::platformName());
+    result.insert("benchmarks", benchmarks);
+
+    QFile file(resultFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(QJsonDocument(result).toJson()) < 0) {
+        *errorMessage = QString("Cannot write %1: %2").arg(resultFile, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QJsonObject TerminalBenchmark::measureThroughput()
+{
+    struct Workload
+    {
+        const char *name;
+        QByteArray (*chunk)(int);
+    };
+    const Workload workloads[] = {
+        {"plainText", plainChunk},
+        {"compilerOutput", compilerChunk},
+        {"fullScreenRedraw", fullScreenChunk}
+    };
+
+    QTermWidget *terminal = m_container->termWidget();
+    RenderThrottle *throttle = RenderThrottle::forTerminal(terminal);
+
+    QJsonObject results;
+    for (const Workload &workload : workloads) {
+        const QString fileName = m_workDir.filePath(QString::fromLatin1(workload.name));
+        if (!writeWorkload(fileName, workloadBytes, workload.chunk))
+            continue;
+
+        const qint64 bytes = QFileInfo(fileName).size();
+        const qint64 skippedBefore = throttle ? throttle->skippedFrames() : 0;
+        const double seconds = catFile(terminal, fileName);
+
+        QJsonObject result;
+        result.insert("bytes", bytes);
+        result.insert("seconds", seconds);
+        result.insert("mbPerSecond", seconds > 0 ? bytes / 1e6 / seconds : -1);
+        if (throttle)
+            result.insert("skippedFrames", throttle->skippedFrames() - skippedBefore);
+        results.insert(QString::fromLatin1(workload.name), result);
+        QFile::remove(fileName);
+    }
+    return results;
+}
+
+QJsonObject TerminalBenchmark::measureCreateTerminal()
+{
+    QVector<double> created;
+    QVector<double> interactive;
+
+    const QString emptyFile = m_workDir.filePath("empty");
+    QFile(emptyFile).open(QIODevice::WriteOnly);
+
+    for (int i = 0; i < sampleCount; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        m_container->createTerminal();
+        created.append(milliseconds(timer));
+
+        // The shell is interactive once it ran a command.
+        catFile(m_container->termWidget(), emptyFile);
+        interactive.append(milliseconds(timer));
+    }
+
+    QJsonObject result;
+    result.insert("createdMs", summarize(created));
+    result.insert("interactiveMs", summarize(interactive));
+    return result;
+}
+
+QJsonObject TerminalBenchmark::measureTabSwitch()
+{
+    TerminalListModel *terminals = m_container->terminalList();
+    QVector<double> samples;
+
+    for (int i = 0; i < sampleCount * 2 && terminals->rowCount() > 1; ++i) {
+        const int index = i % terminals->rowCount();
+        QTermWidget *terminal = terminals->terminal(index);
+        if (terminal == m_container->termWidget())
+            continue;
+
+        PaintWatcher watcher(terminal);
+        QElapsedTimer timer;
+        timer.start();
+        m_container->setCurrentIndex(index);
+        if (waitFor([&watcher] { return watcher.painted; }, 5000))
+            samples.append(milliseconds(timer));
+    }
+
+    return summarize(samples);
+}
+
+QJsonObject TerminalBenchmark::measureInputLatency()
+{
+    QTermWidget *terminal = m_container->initializeTerm(QString(), false);
+    terminal->setGeometry(m_container->rect());
+    terminal->show();
+    terminal->raise();
+
+    LatencyProbe probe(terminal);
+    probe.start(TerminalContainer::shellEnvironment());
+    waitFor([&probe] { return !probe.isRunning(); });
+
+    const QJsonObject result = probe.toJson();
+    delete terminal;
+    return result;
+}
+
+QJsonObject TerminalBenchmark::measureSearch()
+{
+    // A terminal without a shell, only used to own the store.
+    QTermWidget terminal(0);
+    auto store = new ScrollbackStore(&terminal);
+    store->setBudget(1024LL * 1024 * 1024);
+
+    QByteArray chunk;
+    for (int i = 0; i < searchLines; ++i) {
+        chunk += (i % 4 == 0) ? compilerChunk(i) : plainChunk(i);
+        if (chunk.size() > 1024 * 1024) {
+            store->append(chunk);
+            chunk.clear();
+        }
+    }
+    store->append(chunk);
+    store->flush();
+
+    struct Query
+    {
+        const char *name;
+        const char *pattern;
+        Core::FindFlags flags;
+    };
+    const Query queries[] = {
+        {"plainText", "undeclared identifier 'value999996'", Core::FindCaseSensitively},
+        {"caseInsensitive", "LAZY DOG, AGAIN", Core::FindFlags()},
+        {"regularExpression", "value\\d+7\\b", Core::FindRegularExpression}
+    };
+
+    const ScrollbackSnapshot snapshot = store->snapshot();
+    QJsonObject results;
+    results.insert("lines", snapshot.lineCount());
+    results.insert("memoryBytes", store->memoryBytes());
+    results.insert("diskBytes", store->diskBytes());
+
+    for (const Query &query : queries) {
+        const ScrollbackSearch search(QString::fromLatin1(query.pattern), query.flags);
+        QVector<double> samples;
+        int matches = 0;
+        for (int i = 0; i < 3; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            matches = search.search(snapshot, snapshot.firstLine(), snapshot.endLine()).size();
+            samples.append(milliseconds(timer));
+        }
+        QJsonObject result = summarize(samples);
+        result.insert("matches", matches);
+        results.insert(QString::fromLatin1(query.name), result);
+    }
+    return results;
+}
+
+QJsonObject TerminalBenchmark::measureMemory()
+{
+    const QString fileName = m_workDir.filePath("memory");
+    writeWorkload(fileName, memoryWorkloadBytes, compilerChunk);
+
+    const qint64 before = residentKiB("VmRSS:");
+    for (int i = 0; i < sampleCount; ++i) {
+        m_container->createTerminal();
+        catFile(m_container->termWidget(), fileName);
+    }
+    const qint64 after = residentKiB("VmRSS:");
+
+    QJsonObject result;
+    result.insert("tabs", sampleCount);
+    result.insert("outputBytesPerTab", QFileInfo(fileName).size());
+    result.insert("rssKiBPerTab", before < 0 ? -1 : double(after - before) / sampleCount);
+    result.insert("peakRssKiB", residentKiB("VmHWM:"));
+    return result;
+}
+
+// Lets the shell cat fileName and returns the seconds until all output has
+// been received, or -1 on timeout.
+double TerminalBenchmark::catFile(QTermWidget *terminal, const QString &fileName)
+{
+    // The shell echoes the command with the escaped marker, only the output
+    // of printf contains the marker itself.
+    const QByteArray marker = QString("qtc-benchmark-%1").arg(++m_markerCount).toLatin1();
+    QString escapedMarker;
+    for (char c : marker)
+        escapedMarker += QString("\\%1").arg(int(c), 3, 8, QChar('0'));
+
+    bool done = false;
+    QByteArray tail;
+    const QMetaObject::Connection connection = QObject::connect(
+                terminal, &QTermWidget::receivedData, [&](const QString &data) {
+        const QByteArray window = tail + data.toLatin1();
+        done = done || window.contains(marker);
+        tail = window.right(marker.size());
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    terminal->sendText(QString(" cat '%1'; printf '%2\\n'\n").arg(fileName, escapedMarker));
+    const bool finished = waitFor([&done] { return done; });
+    const double seconds = timer.nsecsElapsed() / 1e9;
+
+    QObject::disconnect(connection);
+    return finished ? seconds : -1;
+}
+
+bool TerminalBenchmark::writeWorkload(const QString &fileName,
+                                      qint64 size,
+                                      const std::function<QByteArray(int)> &chunk)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray buffer;
+    for (int i = 0; file.size() + buffer.size() < size; ++i) {
+        buffer += chunk(i);
+        if (buffer.size() >= 1024 * 1024) {
+            file.write(buffer);
+            buffer.clear();
+        }
+    }
+    return file.write(buffer) >= 0;
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef TERMINALBENCHMARK_H
+#define TERMINALBENCHMARK_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QTemporaryDir>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QWidget)
+
+namespace Terminal {
+namespace Internal {
+
+class TerminalContainer;
+
+/*! Benchmarks of the terminal plugin, run with
+    "qtcreator -terminal-benchmark <result file>".
+
+    The benchmarks use a terminal container of their own, so they can run
+    offscreen (QT_QPA_PLATFORM=offscreen). The results are written as JSON,
+    to be compared across versions.
+*/
+class TerminalBenchmark
+{
+public:
+    TerminalBenchmark();
+    ~TerminalBenchmark();
+
+    bool run(const QString &resultFile, QString *errorMessage);
+
+private:
+    QJsonObject measureThroughput();
+    QJsonObject measureCreateTerminal();
+    QJsonObject measureTabSwitch();
+    QJsonObject measureInputLatency();
+    QJsonObject measureSearch();
+    QJsonObject measureMemory();
+
+    double catFile(QTermWidget *terminal, const QString &fileName);
+    bool writeWorkload(const QString &fileName, qint64 size,
+                       const std::function<QByteArray(int)> &chunk);
+
+    QWidget *m_host;
+    TerminalContainer *m_container;
+    QTemporaryDir m_workDir;
+    int m_markerCount;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // TERMINALBENCHMARK_H
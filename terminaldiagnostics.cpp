@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "terminaldiagnostics.h"
+#include "hibernator.h"
+#include "perfcounters.h"
+#include "ptyiothread.h"
+#include "scrollbackstore.h"
+#include "terminallistmodel.h"
+
+#include <QDateTime>
+#include <QDialogButtonBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocale>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+// Upper limit of the latency bucket holding the given fraction of paints.
+static QString latencyPercentile(const QVector<qint64> &histogram, double fraction)
+{
+    qint64 total = 0;
+    for (qint64 count : histogram)
+        total += count;
+    if (total == 0)
+        return QString("-");
+
+    const QVector<int> limits = PerfCounters::latencyBucketLimits();
+    qint64 seen = 0;
+    for (int i = 0; i < histogram.size(); ++i) {
+        seen += histogram.at(i);
+        if (seen >= total * fraction)
+            return i < limits.size() ? QString("< %1").arg(limits.at(i)) : QString("> %1").arg(limits.last());
+    }
+    return QString("-");
+}
+
+TerminalDiagnostics::TerminalDiagnostics(TerminalListModel *terminals, QWidget *parent)
+    : QDialog(parent)
+    , m_terminals(terminals)
+    , m_view(new QTreeWidget(this))
+    , m_refreshTimer(new QTimer(this))
+{
+    setWindowTitle(tr("Terminal Performance Diagnostics"));
+    setAttribute(Qt::WA_DeleteOnClose);
+    resize(900, 300);
+
+    m_view->setRootIsDecorated(false);
+    m_view->setUniformRowHeights(true);
+    m_view->setHeaderLabels({tr("Terminal"), tr("Shell PID"), tr("Bytes Read"),
+                             tr("Paints"), tr("Paint Time (ms)"),
+                             tr("Latency p50 (ms)"), tr("Latency p95 (ms)"),
+                             tr("Scrollback Lines"), tr("Scrollback Memory"), tr("Scrollback Disk"),
+                             tr("Hibernation Saved")});
+    m_view->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton *reset = buttons->addButton(tr("Reset"), QDialogButtonBox::ResetRole);
+    QPushButton *save = buttons->addButton(tr("Save as JSON..."), QDialogButtonBox::ActionRole);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(reset, &QPushButton::clicked, this, &TerminalDiagnostics::resetCounters);
+    connect(save, &QPushButton::clicked, this, &TerminalDiagnostics::saveJson);
+
+    auto layout = new QVBoxLayout(this);
+    layout->addWidget(m_view);
+    layout->addWidget(buttons);
+
+    PerfCounters::setDetailedTracking(true);
+
+    m_refreshTimer->setInterval(1000);
+    connect(m_refreshTimer, &QTimer::timeout, this, &TerminalDiagnostics::refresh);
+    m_refreshTimer->start();
+    refresh();
+}
+
+TerminalDiagnostics::~TerminalDiagnostics()
+{
+    PerfCounters::setDetailedTracking(false);
+}
+
+void TerminalDiagnostics::refresh()
+{
+    const QLocale locale;
+    const int rows = m_terminals->rowCount();
+
+    while (m_view->topLevelItemCount() > rows)
+        delete m_view->takeTopLevelItem(m_view->topLevelItemCount() - 1);
+    while (m_view->topLevelItemCount() < rows)
+        m_view->addTopLevelItem(new QTreeWidgetItem);
+
+    for (int row = 0; row < rows; ++row) {
+        QTreeWidgetItem *item = m_view->topLevelItem(row);
+        QTermWidget *terminal = m_terminals->terminal(row);
+        PerfCounters *counters = PerfCounters::forTerminal(terminal);
+        ScrollbackStore *store = ScrollbackStore::forTerminal(terminal);
+
+        item->setText(0, m_terminals->name(row));
+        item->setText(1, terminal ? QString::number(PtyChannel::shellPid(terminal)) : QString());
+        if (counters) {
+            const QVector<qint64> histogram = counters->latencyHistogram();
+            item->setText(2, locale.formattedDataSize(counters->bytesRead()));
+            item->setText(3, QString::number(counters->paintCount()));
+            item->setText(4, QString::number(counters->paintMilliseconds(), 'f', 1));
+            item->setText(5, latencyPercentile(histogram, 0.5));
+            item->setText(6, latencyPercentile(histogram, 0.95));
+        }
+        if (store) {
+            item->setText(7, QString::number(store->lineCount()));
+            item->setText(8, locale.formattedDataSize(store->memoryBytes()));
+            item->setText(9, locale.formattedDataSize(store->diskBytes()));
+        }
+        const Hibernator *hibernator = Hibernator::forTerminal(terminal);
+        item->setText(10, hibernator && hibernator->isHibernated()
+                              ? locale.formattedDataSize(hibernator->savedBytes()) : QString("-"));
+    }
+
+    setWindowTitle(tr("Terminal Performance Diagnostics (hibernation saved %1)")
+                   .arg(locale.formattedDataSize(Hibernator::totalSavedBytes())));
+}
+
+void TerminalDiagnostics::resetCounters()
+{
+    for (int row = 0; row < m_terminals->rowCount(); ++row) {
+        if (PerfCounters *counters = PerfCounters::forTerminal(m_terminals->terminal(row)))
+            counters->reset();
+    }
+    refresh();
+}
+
+void TerminalDiagnostics::saveJson()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Save Diagnostics"),
+                                                          QString(), tr("JSON Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(QJsonDocument(toJson()).toJson()) < 0) {
+        QMessageBox::warning(this, tr("Save Diagnostics"),
+                             tr("Cannot write %1: %2").arg(fileName, file.errorString()));
+    }
+}
+
+QJsonObject TerminalDiagnostics::toJson() const
+{
+    QJsonArray terminals;
+    for (int row = 0; row < m_terminals->rowCount(); ++row) {
+        PerfCounters *counters = PerfCounters::forTerminal(m_terminals->terminal(row));
+        QJsonObject terminal = counters ? counters->toJson() : QJsonObject();
+        terminal.insert("name", m_terminals->name(row));
+        terminals.append(terminal);
+    }
+
+    QJsonObject result;
+    result.insert("date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    result.insert("terminals", terminals);
+    result.insert("hibernationSavedBytes", Hibernator::totalSavedBytes());
+    return result;
+}
+
+} // namespace Internal
+} // namespace Terminal
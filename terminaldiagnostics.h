@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef TERMINALDIAGNOSTICS_H
+#define TERMINALDIAGNOSTICS_H
+
+#include <QDialog>
+#include <QJsonObject>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(QTreeWidget)
+
+namespace Terminal {
+namespace Internal {
+
+class TerminalListModel;
+
+/*! Shows the performance counters of all terminals.
+
+    Detailed tracking is enabled for as long as the dialog exists, the
+    counters are refreshed once per second.
+*/
+class TerminalDiagnostics : public QDialog
+{
+    Q_OBJECT
+
+public:
+    TerminalDiagnostics(TerminalListModel *terminals, QWidget *parent = nullptr);
+    ~TerminalDiagnostics();
+
+private:
+    void refresh();
+    void resetCounters();
+    void saveJson();
+    QJsonObject toJson() const;
+
+    TerminalListModel *m_terminals;
+    QTreeWidget *m_view;
+    QTimer *m_refreshTimer;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // TERMINALDIAGNOSTICS_H
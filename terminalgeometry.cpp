@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "terminalgeometry.h"
+#include "scrollbackstore.h"
+
+#include <QScrollBar>
+#include <QVector>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+namespace TerminalGeometry {
+
+static int wrappedRows(const QByteArray &rawLine, int columns)
+{
+    const int width = ScrollbackStore::plainText(rawLine).size();
+    return qMax(1, (width + columns - 1) / columns);
+}
+
+int widgetLine(QTermWidget *terminal,
+               const ScrollbackSnapshot &snapshot,
+               qint64 storeLine,
+               int column,
+               int *widgetColumn)
+{
+    const int columns = qMax(1, terminal->screenColumnsCount());
+    const int historyLines = terminal->historyLinesCount();
+    const int widgetLines = historyLines + terminal->screenLinesCount();
+
+    // Only the last widgetLines store lines can still be in the widget.
+    const qint64 first = qMax(snapshot.firstLine(), snapshot.endLine() - widgetLines);
+    if (storeLine < first || storeLine >= snapshot.endLine())
+        return -1;
+
+    QVector<int> rows;
+    rows.reserve(int(snapshot.endLine() - first));
+    snapshot.forEachLine(first, snapshot.endLine(), [&](qint64, const QByteArray &rawLine) {
+        rows.append(wrappedRows(rawLine, columns));
+        return true;
+    });
+
+    int totalRows = 0;
+    for (int r : qAsConst(rows))
+        totalRows += r;
+
+    // Without any history the output starts at the top of the screen,
+    // otherwise the cursor sits on the last line of the screen.
+    int lastRow = historyLines > 0 ? widgetLines - 1 : qMin(totalRows, widgetLines) - 1;
+    if (!snapshot.endsWithPartialLine())
+        --lastRow;
+
+    int row = lastRow + 1;
+    for (int i = rows.count() - 1; i >= int(storeLine - first); --i)
+        row -= rows.at(i);
+
+    row += column / columns;
+    if (row < 0)
+        return -1;
+
+    if (widgetColumn)
+        *widgetColumn = column % columns;
+    return row;
+}
+
+void reveal(QTermWidget *terminal, int widgetLine, int column, int length)
+{
+    terminal->setSelectionStart(widgetLine, column);
+    terminal->setSelectionEnd(widgetLine, column + length - 1);
+
+    // The scroll bar drives the terminal's screen window. Moving it scrolls
+    // the display and makes it pick up the new selection, so make sure it
+    // moves even if the line is already visible.
+    auto scrollBar = terminal->findChild<QScrollBar *>();
+    if (!scrollBar)
+        return;
+
+    const int top = qBound(scrollBar->minimum(),
+                           widgetLine - terminal->screenLinesCount() / 2,
+                           scrollBar->maximum());
+    if (top == scrollBar->value())
+        scrollBar->setValue(top > scrollBar->minimum() ? top - 1 : top + 1);
+    scrollBar->setValue(top);
+}
+
+QWidget *display(QTermWidget *terminal)
+{
+    for (QWidget *child : terminal->findChildren<QWidget *>()) {
+        if (QByteArray(child->metaObject()->className()).endsWith("TerminalDisplay"))
+            return child;
+    }
+    return terminal;
+}
+
+} // namespace TerminalGeometry
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef TERMINALGEOMETRY_H
+#define TERMINALGEOMETRY_H
+
+#include <QtGlobal>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QWidget)
+
+namespace Terminal {
+namespace Internal {
+
+class ScrollbackSnapshot;
+
+/*! Maps between lines of a terminal's scrollback store and the lines of its
+    widget (history followed by the screen).
+
+    The widget only holds the most recent part of the output and wraps long
+    lines, while the store keeps every line as it was received. The mapping
+    counts wrapped rows back from the end of the output, assuming the cursor
+    is on the last line with output. That holds for shells and build output,
+    but not after the screen has been cleared or for full-screen programs.
+*/
+namespace TerminalGeometry {
+
+// Returns the widget line of storeLine, or -1 if it is no longer part of
+// the widget's history. column is converted to the wrapped widget column.
+int widgetLine(QTermWidget *terminal,
+               const ScrollbackSnapshot &snapshot,
+               qint64 storeLine,
+               int column,
+               int *widgetColumn);
+
+// Scrolls the terminal so that widgetLine is visible and selects length
+// characters starting at column.
+void reveal(QTermWidget *terminal, int widgetLine, int column, int length);
+
+// Returns qtermwidget's TerminalDisplay child, which receives the key events
+// and paints the output, or terminal itself if there is none.
+QWidget *display(QTermWidget *terminal);
+
+} // namespace TerminalGeometry
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // TERMINALGEOMETRY_H
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "terminallistmodel.h"
+
+#include <utils/qtcassert.h>
+
+#include <QLocale>
+
+namespace Terminal {
+namespace Internal {
+
+TerminalListModel::TerminalListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int TerminalListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant TerminalListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.size())
+        return QVariant();
+
+    const Item &item = m_items.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        if (item.logSize >= 0) {
+            return QString("%1: %2 [%3]").arg(QString::number(index.row() + 1), item.name,
+                                              QLocale().formattedDataSize(item.logSize));
+        }
+        return QString("%1: %2").arg(QString::number(index.row() + 1), item.name);
+    case Qt::EditRole:
+    case Qt::ToolTipRole:
+        return item.name;
+    default:
+        return QVariant();
+    }
+}
+
+QTermWidget *TerminalListModel::terminal(int row) const
+{
+    return row >= 0 && row < m_items.size() ? m_items.at(row).terminal.data() : nullptr;
+}
+
+QString TerminalListModel::name(int row) const
+{
+    return row >= 0 && row < m_items.size() ? m_items.at(row).name : QString();
+}
+
+int TerminalListModel::indexOf(QTermWidget *terminal) const
+{
+    for (int row = 0; row < m_items.size(); ++row) {
+        if (m_items.at(row).terminal == terminal)
+            return row;
+    }
+    return -1;
+}
+
+void TerminalListModel::insertTerminal(int row, QTermWidget *terminal, const QString &name)
+{
+    QTC_ASSERT(row >= 0 && row <= m_items.size(), row = m_items.size());
+
+    beginInsertRows(QModelIndex(), row, row);
+    m_items.insert(row, {terminal, name, -1});
+    endInsertRows();
+    positionsChanged(row + 1, m_items.size() - 1);
+}
+
+void TerminalListModel::removeTerminal(int row)
+{
+    QTC_ASSERT(row >= 0 && row < m_items.size(), return);
+
+    beginRemoveRows(QModelIndex(), row, row);
+    m_items.remove(row);
+    endRemoveRows();
+    positionsChanged(row, m_items.size() - 1);
+}
+
+void TerminalListModel::moveTerminal(int from, int to)
+{
+    QTC_ASSERT(from >= 0 && from < m_items.size(), return);
+    QTC_ASSERT(to >= 0 && to < m_items.size(), return);
+    if (from == to)
+        return;
+
+    // beginMoveRows() wants the row the item is inserted before.
+    beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+    m_items.move(from, to);
+    endMoveRows();
+    positionsChanged(qMin(from, to), qMax(from, to));
+}
+
+void TerminalListModel::setName(int row, const QString &name)
+{
+    QTC_ASSERT(row >= 0 && row < m_items.size(), return);
+    if (m_items.at(row).name == name)
+        return;
+
+    m_items[row].name = name;
+    emit dataChanged(index(row), index(row));
+}
+
+void TerminalListModel::setLogSize(int row, qint64 bytes)
+{
+    QTC_ASSERT(row >= 0 && row < m_items.size(), return);
+    if (m_items.at(row).logSize == bytes)
+        return;
+
+    m_items[row].logSize = bytes;
+    emit dataChanged(index(row), index(row), {Qt::DisplayRole});
+}
+
+// The displayed position is part of the text of every row after a change.
+void TerminalListModel::positionsChanged(int first, int last)
+{
+    if (first <= last)
+        emit dataChanged(index(first), index(last), {Qt::DisplayRole});
+}
+
+} // namespace Internal
+} // namespace Terminal
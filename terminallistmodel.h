@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef TERMINALLISTMODEL_H
+#define TERMINALLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QPointer>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+
+namespace Terminal {
+namespace Internal {
+
+/*! The list of open terminals and their names, in tab order.
+
+    The tab widget and the toolbar's combo box both follow this model, so
+    every change only touches the affected rows. Items are displayed as
+    "<position>: <name>", followed by the size of the output log if the
+    terminal is logged. The edit role holds the plain name.
+*/
+class TerminalListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit TerminalListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    QTermWidget *terminal(int row) const;
+    QString name(int row) const;
+    int indexOf(QTermWidget *terminal) const;
+
+    void insertTerminal(int row, QTermWidget *terminal, const QString &name);
+    void removeTerminal(int row);
+    void moveTerminal(int from, int to);
+    void setName(int row, const QString &name);
+    // Pass -1 for terminals that are not logged.
+    void setLogSize(int row, qint64 bytes);
+
+private:
+    struct Item
+    {
+        QPointer<QTermWidget> terminal;
+        QString name;
+        qint64 logSize;
+    };
+
+    void positionsChanged(int first, int last);
+
+    QVector<Item> m_items;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // TERMINALLISTMODEL_H
@@ -4,6 +4,10 @@
 
 #include "terminalplugin.h"
 #include "terminalwindow.h"
+#include "ptyiothread.h"
+#include "startuptiming.h"
+#include "terminalbenchmark.h"
+#include "terminalsettings.h"
 
 #include <coreplugin/actionmanager/actionmanager.h>
 #include <coreplugin/actionmanager/actioncontainer.h>
@@ -19,6 +23,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QTimer>
 
 namespace Terminal {
 namespace Internal {
@@ -32,6 +37,7 @@ namespace Internal {
 TerminalPlugin::TerminalPlugin()
     : m_window(nullptr)
 {
+    StartupTiming::mark("TerminalPlugin loaded");
 }
 
 /*! Plugins are responsible for deleting objects they created on the heap, and
@@ -52,11 +58,21 @@ TerminalPlugin::~TerminalPlugin()
 */
 bool TerminalPlugin::initialize(const QStringList &arguments, QString *errorMessage)
 {
-    Q_UNUSED(arguments)
-    Q_UNUSED(errorMessage)
+    const int benchmarkArgument = arguments.indexOf("-terminal-benchmark");
+    if (benchmarkArgument >= 0) {
+        m_benchmarkResultFile = arguments.value(benchmarkArgument + 1);
+        if (m_benchmarkResultFile.isEmpty()) {
+            *errorMessage = tr("-terminal-benchmark needs the name of the result file.");
+            return false;
+        }
+    }
 
+    StartupTiming::mark("TerminalPlugin::initialize started");
+    new TerminalSettings(this);
+    new PtyIoThread(this);
     m_window = new TerminalWindow(this);
     ExtensionSystem::PluginManager::instance()->addObject(m_window);
+    StartupTiming::mark("TerminalPlugin::initialize finished");
     return true;
 }
 
@@ -68,11 +84,34 @@ bool TerminalPlugin::initialize(const QStringList &arguments, QString *errorMess
     interested in. These objects can now be requested through the
     PluginManagerInterface.
 
-    The TerminalPlugin doesn't need things from other plugins, so it does
-    nothing here.
+    The TerminalPlugin doesn't need things from other plugins, so it only
+    reports its startup timing here, and schedules the benchmarks if they
+    were requested on the command line.
 */
 void TerminalPlugin::extensionsInitialized()
 {
+    StartupTiming::mark("TerminalPlugin::extensionsInitialized");
+
+    if (!m_benchmarkResultFile.isEmpty()) {
+        connect(Core::ICore::instance(), &Core::ICore::coreOpened, this, [this] {
+            QTimer::singleShot(0, this, &TerminalPlugin::runBenchmark);
+        });
+    }
+}
+
+/*! Runs the benchmarks, writes their results and quits.
+*/
+void TerminalPlugin::runBenchmark()
+{
+    QString errorMessage;
+    bool success;
+    {
+        TerminalBenchmark benchmark;
+        success = benchmark.run(m_benchmarkResultFile, &errorMessage);
+    }
+    if (!success)
+        qWarning("Terminal benchmark failed: %s", qPrintable(errorMessage));
+    QCoreApplication::exit(success ? 0 : 1);
 }
 
 } // namespace Internal
@@ -26,7 +26,10 @@ public:
     void extensionsInitialized();
 
 private:
+    void runBenchmark();
+
     TerminalWindow *m_window;
+    QString m_benchmarkResultFile;
 };
 
 } // namespace Internal
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "terminalsession.h"
+#include "ptyiothread.h"
+
+#include "scrollbackstore.h"
+#include "terminallistmodel.h"
+
+#include <utils/qtcassert.h>
+#include <utils/runextensions.h>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QTimer>
+
+#include <qtermwidget5/qtermwidget.h>
+
+namespace Terminal {
+namespace Internal {
+
+static Q_LOGGING_CATEGORY(sessionLog, "qtc.terminal.session", QtWarningMsg)
+
+static const quint32 fileMagic = 0x51545453; // "QTTS"
+static const quint32 fileVersion = 1;
+
+// Only the end of a long history is saved.
+static const int maxSavedLines = 10000;
+static const int maxSavedBytes = 8 * 1024 * 1024;
+// Output is compressed for the next save at most this often per terminal.
+static const int historyUpdateDelayMs = 5000;
+
+// Runs in a worker thread, or in save() for output not compressed yet.
+TerminalSession::History TerminalSession::compressHistory(const ScrollbackSnapshot &snapshot)
+{
+    // The unfinished last line is the prompt, the restored shell prints a
+    // new one.
+    const qint64 endLine = snapshot.endLine();
+    const qint64 from = qMax(snapshot.firstLine(), endLine - maxSavedLines);
+    QVector<QByteArray> lines;
+    qint64 bytes = 0;
+    snapshot.forEachLine(from, endLine, [&](qint64, const QByteArray &rawLine) {
+        // Escape sequences would be replayed as well, e.g. switching to the
+        // alternate screen or turning on mouse tracking.
+        const QByteArray line = ScrollbackStore::plainText(rawLine).toUtf8();
+        lines.append(line);
+        bytes += line.size() + 1;
+        return true;
+    });
+
+    int first = 0;
+    while (bytes > maxSavedBytes && first < lines.count())
+        bytes -= lines.at(first++).size() + 1;
+
+    QByteArray raw;
+    raw.reserve(int(bytes));
+    for (int i = first; i < lines.count(); ++i) {
+        raw.append(lines.at(i));
+        raw.append('\n');
+    }
+
+    return {endLine, raw.isEmpty() ? QByteArray() : qCompress(raw, 1)};
+}
+
+TerminalSession::TerminalSession(QObject *parent)
+    : QObject(parent)
+    , m_updateTimer(new QTimer(this))
+{
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(historyUpdateDelayMs);
+    connect(m_updateTimer, &QTimer::timeout, this, [this] {
+        const QSet<QTermWidget *> outdated = m_outdated;
+        m_outdated.clear();
+        for (QTermWidget *terminal : outdated)
+            updateHistory(terminal);
+    });
+}
+
+TerminalSession::~TerminalSession()
+{
+    // The workers only read snapshots, but the plugin may be unloaded.
+    for (QFutureWatcher<History> *watcher : qAsConst(m_compressions))
+        watcher->waitForFinished();
+}
+
+QString TerminalSession::fileName(const QString &session)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+            + "/terminal-sessions/" + session + ".qtterm";
+}
+
+QVector<TerminalSession::Tab> TerminalSession::load(const QString &session, int *currentIndex)
+{
+    m_sessionName = session;
+    m_fileName = fileName(session);
+    m_entries.clear();
+    m_pending.clear();
+    *currentIndex = 0;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 current = 0;
+    qint32 count = 0;
+    in >> magic >> version >> current >> count;
+    if (in.status() != QDataStream::Ok || magic != fileMagic || version != fileVersion || count < 0) {
+        qCWarning(sessionLog, "Ignoring invalid terminal session file %s", qPrintable(m_fileName));
+        return {};
+    }
+
+    QVector<Entry> entries;
+    for (int i = 0; i < count; ++i) {
+        Entry entry;
+        in >> entry.tab.name >> entry.tab.workingDirectory >> entry.offset >> entry.size;
+        if (in.status() != QDataStream::Ok) {
+            qCWarning(sessionLog, "Ignoring truncated terminal session file %s", qPrintable(m_fileName));
+            return {};
+        }
+        entries.append(entry);
+    }
+
+    // The offsets are relative to the end of the index.
+    const qint64 historyBase = file.pos();
+    for (Entry &entry : entries)
+        entry.offset += historyBase;
+    m_entries = entries;
+
+    QVector<Tab> tabs;
+    tabs.reserve(entries.count());
+    for (const Entry &entry : qAsConst(entries))
+        tabs.append(entry.tab);
+
+    *currentIndex = qBound(0, int(current), qMax(0, tabs.count() - 1));
+    return tabs;
+}
+
+QString TerminalSession::sessionName() const
+{
+    return m_sessionName;
+}
+
+void TerminalSession::adopt(int index, QTermWidget *terminal)
+{
+    QTC_ASSERT(index >= 0 && index < m_entries.count(), return);
+    m_pending.insert(terminal, m_entries.at(index));
+    watch(terminal);
+}
+
+bool TerminalSession::isPending(QTermWidget *terminal) const
+{
+    return m_pending.contains(terminal);
+}
+
+void TerminalSession::start(QTermWidget *terminal, const QStringList &environment)
+{
+    const QByteArray history = qUncompress(readHistory(m_pending.take(terminal)));
+
+    if (!history.isEmpty()) {
+        QTemporaryFile file(QDir::tempPath() + "/qtc-terminal-XXXXXX.history");
+        file.setAutoRemove(false);
+        if (file.open() && file.write(history) == history.size()) {
+            file.close();
+            // The script removes the file once it has been printed.
+            PtyChannel::startShellProgram(terminal, environment, "/bin/sh",
+                                          {"-c", "cat \"$0\"; rm -f \"$0\"; exec \"${SHELL:-/bin/sh}\"",
+                                           file.fileName()});
+            return;
+        }
+        qCWarning(sessionLog, "Cannot write terminal history to %s: %s",
+                  qPrintable(file.fileName()), qPrintable(file.errorString()));
+        file.remove();
+    }
+
+    PtyChannel::startShellProgram(terminal, environment);
+}
+
+bool TerminalSession::save(const TerminalListModel *terminals, int currentIndex)
+{
+    if (m_fileName.isEmpty())
+        return false;
+
+    QVector<Entry> entries;
+    QVector<QByteArray> histories;
+
+    // The history of terminals that have not been started yet is still in
+    // the old file, it has to be read before the file is replaced.
+    for (int row = 0; row < terminals->rowCount(); ++row) {
+        QTermWidget *terminal = terminals->terminal(row);
+        if (!terminal)
+            continue;
+
+        Entry entry;
+        entry.tab.name = terminals->name(row);
+        QByteArray history;
+        if (m_pending.contains(terminal)) {
+            const Entry pending = m_pending.value(terminal);
+            entry.tab.workingDirectory = pending.tab.workingDirectory;
+            history = readHistory(pending);
+        } else {
+            entry.tab.workingDirectory = PtyChannel::workingDirectory(terminal);
+            history = currentHistory(terminal);
+        }
+        entry.size = history.size();
+        entries.append(entry);
+        histories.append(history);
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(sessionLog, "Cannot save terminal session to %s: %s",
+                  qPrintable(m_fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << fileMagic << fileVersion << qint32(currentIndex) << qint32(entries.count());
+
+    qint64 offset = 0;
+    for (Entry &entry : entries) {
+        entry.offset = offset;
+        offset += entry.size;
+        out << entry.tab.name << entry.tab.workingDirectory << entry.offset << entry.size;
+    }
+
+    const qint64 historyBase = file.pos();
+    for (const QByteArray &history : qAsConst(histories))
+        file.write(history);
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(sessionLog, "Cannot save terminal session to %s: %s",
+                  qPrintable(m_fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    // Pending terminals now find their history at its new offset.
+    for (int row = 0, i = 0; row < terminals->rowCount(); ++row) {
+        QTermWidget *terminal = terminals->terminal(row);
+        if (!terminal)
+            continue;
+        Entry entry = entries.at(i++);
+        entry.offset += historyBase;
+        if (m_pending.contains(terminal))
+            m_pending.insert(terminal, entry);
+    }
+
+    return true;
+}
+
+void TerminalSession::watch(QTermWidget *terminal)
+{
+    if (m_tracked.contains(terminal))
+        return;
+
+    m_tracked.insert(terminal);
+    connect(terminal, &QTermWidget::receivedData, this, [this, terminal] {
+        m_outdated.insert(terminal);
+        if (!m_updateTimer->isActive())
+            m_updateTimer->start();
+    });
+    connect(terminal, &QObject::destroyed, this, [this, terminal] {
+        m_tracked.remove(terminal);
+        m_pending.remove(terminal);
+        m_history.remove(terminal);
+        m_outdated.remove(terminal);
+        if (QFutureWatcher<History> *watcher = m_compressions.take(terminal)) {
+            watcher->disconnect(this);
+            watcher->cancel();
+            watcher->deleteLater();
+        }
+    });
+}
+
+QByteArray TerminalSession::readHistory(const Entry &entry) const
+{
+    if (entry.size <= 0)
+        return QByteArray();
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(entry.offset))
+        return QByteArray();
+
+    const QByteArray history = file.read(entry.size);
+    return history.size() == entry.size ? history : QByteArray();
+}
+
+void TerminalSession::updateHistory(QTermWidget *terminal)
+{
+    ScrollbackStore *store = ScrollbackStore::forTerminal(terminal);
+    if (!store)
+        return;
+
+    // Output that came in meanwhile is compressed on the next round.
+    if (m_compressions.contains(terminal)) {
+        m_outdated.insert(terminal);
+        if (!m_updateTimer->isActive())
+            m_updateTimer->start();
+        return;
+    }
+
+    // Terminals that had no output since the last compression are not
+    // compressed again.
+    auto cached = m_history.constFind(terminal);
+    if (cached != m_history.constEnd() && cached->endLine == store->endLine())
+        return;
+
+    auto watcher = new QFutureWatcher<History>(this);
+    connect(watcher, &QFutureWatcher<History>::finished, this, [this, terminal, watcher] {
+        m_compressions.remove(terminal);
+        if (!watcher->future().isCanceled())
+            m_history.insert(terminal, watcher->result());
+        watcher->deleteLater();
+    });
+    watch(terminal);
+    m_compressions.insert(terminal, watcher);
+    watcher->setFuture(Utils::runAsync(&TerminalSession::compressHistory, store->snapshot()));
+}
+
+QByteArray TerminalSession::currentHistory(QTermWidget *terminal)
+{
+    ScrollbackStore *store = ScrollbackStore::forTerminal(terminal);
+    if (!store)
+        return QByteArray();
+
+    // The save may be the last one before quitting, it cannot leave out
+    // output that has not been compressed yet.
+    if (QFutureWatcher<History> *watcher = m_compressions.take(terminal)) {
+        watcher->disconnect(this);
+        watcher->waitForFinished();
+        if (!watcher->future().isCanceled())
+            m_history.insert(terminal, watcher->result());
+        watcher->deleteLater();
+    }
+
+    auto cached = m_history.constFind(terminal);
+    if (cached != m_history.constEnd() && cached->endLine == store->endLine())
+        return cached->compressed;
+
+    const History history = compressHistory(store->snapshot());
+    watch(terminal);
+    m_history.insert(terminal, history);
+    m_outdated.remove(terminal);
+    return history.compressed;
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef TERMINALSESSION_H
+#define TERMINALSESSION_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QTermWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+template <typename T>
+class QFutureWatcher;
+
+namespace Terminal {
+namespace Internal {
+
+class ScrollbackSnapshot;
+class TerminalListModel;
+
+/*! Saves the open terminals with a Qt Creator session and restores them.
+
+    Every session gets a binary file holding a small index (tab names,
+    working directories, current tab) followed by the compressed history of
+    every tab. Restoring only reads the index. The terminals are created
+    without a shell, and the history of a terminal is read when it is
+    started by start(), i.e. when its tab is activated for the first time.
+
+    The history is saved as plain text and replayed through the PTY: the
+    restored shell is started by "/bin/sh -c", which prints the history
+    before it replaces itself by the user's shell. That way the replayed
+    output goes through the same path as any other output and ends up in
+    the scrollback store again.
+
+    Histories are compressed in a worker thread a few seconds after output.
+    save() waits for running compressions and only compresses the histories
+    that had output since.
+*/
+class TerminalSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Tab
+    {
+        QString name;
+        QString workingDirectory;
+    };
+
+    explicit TerminalSession(QObject *parent = nullptr);
+    ~TerminalSession();
+
+    static QString fileName(const QString &session);
+
+    // Reads the index of the session's file and returns the saved tabs.
+    QVector<Tab> load(const QString &session, int *currentIndex);
+    // The session last loaded, save() writes to its file.
+    QString sessionName() const;
+    // Associates the not yet started terminal with the saved tab at index.
+    void adopt(int index, QTermWidget *terminal);
+    bool isPending(QTermWidget *terminal) const;
+    void start(QTermWidget *terminal, const QStringList &environment);
+    // Keeps the terminal's compressed history up to date for save().
+    void watch(QTermWidget *terminal);
+
+    bool save(const TerminalListModel *terminals, int currentIndex);
+
+private:
+    struct Entry
+    {
+        Tab tab;
+        qint64 offset = 0;
+        int size = 0;
+    };
+
+    struct History
+    {
+        qint64 endLine = 0;
+        QByteArray compressed;
+    };
+
+    static History compressHistory(const ScrollbackSnapshot &snapshot);
+    QByteArray readHistory(const Entry &entry) const;
+    void updateHistory(QTermWidget *terminal);
+    QByteArray currentHistory(QTermWidget *terminal);
+
+    QString m_sessionName;
+    QString m_fileName;
+    QVector<Entry> m_entries;
+    QHash<QTermWidget *, Entry> m_pending;
+    QHash<QTermWidget *, History> m_history;
+    QHash<QTermWidget *, QFutureWatcher<History> *> m_compressions;
+    QSet<QTermWidget *> m_outdated;
+    QSet<QTermWidget *> m_tracked;
+    QTimer *m_updateTimer;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // TERMINALSESSION_H
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#include "terminalsettings.h"
+
+#include <utils/qtcassert.h>
+#include <utils/runextensions.h>
+
+#include <QSettings>
+#include <QTimer>
+
+namespace Terminal {
+namespace Internal {
+
+// Changes are written once nothing has changed for this long.
+static const int writeDelayMs = 500;
+
+static TerminalSettings *s_instance = nullptr;
+
+TerminalSettings::TerminalSettings(QObject *parent)
+    : QObject(parent)
+    , m_writeTimer(new QTimer(this))
+{
+    QTC_CHECK(!s_instance);
+    s_instance = this;
+
+    // A single writer keeps the batches in order.
+    m_writer.setMaxThreadCount(1);
+
+    m_writeTimer->setSingleShot(true);
+    m_writeTimer->setInterval(writeDelayMs);
+    connect(m_writeTimer, &QTimer::timeout, this, &TerminalSettings::writePending);
+}
+
+TerminalSettings::~TerminalSettings()
+{
+    sync();
+    s_instance = nullptr;
+}
+
+TerminalSettings *TerminalSettings::instance()
+{
+    return s_instance;
+}
+
+QVariant TerminalSettings::value(const QString &key, const QVariant &defaultValue) const
+{
+    const QVariant value = cachedValue(key);
+    return value.isValid() ? value : defaultValue;
+}
+
+bool TerminalSettings::contains(const QString &key) const
+{
+    return cachedValue(key).isValid();
+}
+
+void TerminalSettings::setValue(const QString &key, const QVariant &value)
+{
+    if (cachedValue(key) == value)
+        return;
+
+    m_values.insert(key, value);
+    m_pending.insert(key, value);
+    m_writeTimer->start();
+    emit changed(key, value);
+}
+
+void TerminalSettings::sync()
+{
+    m_writeTimer->stop();
+    writePending();
+    m_writer.waitForDone();
+}
+
+QVariant TerminalSettings::cachedValue(const QString &key) const
+{
+    auto it = m_values.constFind(key);
+    if (it == m_values.cend()) {
+        // Missing keys are cached as invalid values, so they are only
+        // looked up once as well.
+        QSettings settings;
+        it = m_values.insert(key, settings.value(key));
+    }
+    return it.value();
+}
+
+void TerminalSettings::writePending()
+{
+    if (m_pending.isEmpty())
+        return;
+
+    const QHash<QString, QVariant> changes = m_pending;
+    m_pending.clear();
+
+    Utils::runAsync(&m_writer, [changes] {
+        QSettings settings;
+        for (auto it = changes.cbegin(); it != changes.cend(); ++it)
+            settings.setValue(it.key(), it.value());
+        settings.sync();
+    });
+}
+
+} // namespace Internal
+} // namespace Terminal
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2022 Terminal plugin contributors. All rights reserved.
+ */
+
+#ifndef TERMINALSETTINGS_H
+#define TERMINALSETTINGS_H
+
+#include <QHash>
+#include <QObject>
+#include <QThreadPool>
+#include <QVariant>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace Terminal {
+namespace Internal {
+
+/*! In-memory copy of the plugin's settings.
+
+    Every key is read from QSettings once, on first use. Changes are applied
+    to memory right away and announced through changed(). They are written
+    back in batches, after no change has happened for a short while, on a
+    background thread. sync() writes pending changes at once and waits for
+    them.
+
+    The plugin owns the only instance, use instance() to get it.
+*/
+class TerminalSettings : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TerminalSettings(QObject *parent = nullptr);
+    ~TerminalSettings();
+
+    static TerminalSettings *instance();
+
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+    bool contains(const QString &key) const;
+    void setValue(const QString &key, const QVariant &value);
+
+    void sync();
+
+signals:
+    void changed(const QString &key, const QVariant &value);
+
+private:
+    QVariant cachedValue(const QString &key) const;
+    void writePending();
+
+    mutable QHash<QString, QVariant> m_values;
+    QHash<QString, QVariant> m_pending;
+    QTimer *m_writeTimer;
+    QThreadPool m_writer;
+};
+
+} // namespace Internal
+} // namespace Terminal
+
+#endif // TERMINALSETTINGS_H
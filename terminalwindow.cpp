@@ -6,12 +6,14 @@
 
 #include <coreplugin/actionmanager/actionmanager.h>
 #include <coreplugin/actionmanager/command.h>
+#include <coreplugin/editormanager/documentmodel.h>
 #include <coreplugin/editormanager/editormanager.h>
 #include <coreplugin/editormanager/ieditor.h>
 #include <coreplugin/find/basetextfind.h>
 #include <coreplugin/mainwindow.h>
 #include <coreplugin/icontext.h>
 #include <coreplugin/icore.h>
+#include <coreplugin/idocument.h>
 #include <extensionsystem/pluginmanager.h>
 #include <projectexplorer/projecttree.h>
 #include <projectexplorer/project.h>
@@ -24,23 +26,61 @@
 #include <utils/qtcassert.h>
 #include <utils/algorithm.h>
 #include <utils/filepath.h>
+#include <utils/link.h>
+#include <utils/runextensions.h>
 
 #include <QDir>
 #include <QIcon>
 #include <QMenu>
+#include <QMessageBox>
 #include <QToolButton>
 #include <QVBoxLayout>
 #include <QTabWidget>
 #include <QTabBar>
 #include <QLabel>
+#include <QClipboard>
 #include <QComboBox>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QVector>
+#include <QFileDialog>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QDesktopServices>
+#include <QFocusEvent>
 #include <QGuiApplication>
+#include <QPainter>
+#include <QPixmap>
+#include <QRegularExpression>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QToolTip>
 
 #include <qtermwidget5/qtermwidget.h>
+#include "colorschemecatalog.h"
+#include "diagnosticsparser.h"
+#include "findinterminals.h"
 #include "findsupport.h"
+#include "hibernator.h"
+#include "hotspotdetector.h"
+#include "latencyprobe.h"
+#include "outputlogger.h"
+#include "pastestreamer.h"
+#include "perfcounters.h"
+#include "projectfileindex.h"
+#include "ptyiothread.h"
+#include "renderthrottle.h"
+#include "scrollbackexport.h"
+#include "scrollbackstore.h"
+#include "shellpool.h"
+#include "startuptiming.h"
+#include "terminaldiagnostics.h"
+#include "terminalgeometry.h"
+#include "terminallistmodel.h"
+#include "terminalsession.h"
+#include "terminalsettings.h"
 
 namespace Terminal {
 namespace Internal {
@@ -49,16 +89,77 @@ TerminalContainer::TerminalContainer(QWidget *parent, QComboBox *m_toolbarTermin
     : QWidget(parent)
     , m_layout(nullptr)
     , m_tabWidget(nullptr)
+    , m_placeholder(nullptr)
     , m_toolbarTerminalsComboBox(m_toolbarTerminalsComboBox)
+    , m_fileIndex(nullptr)
+    , m_fileResolver(new QFutureWatcher<QString>(this))
+    , m_shellPool(new ShellPool([this](const QString &workingDirectory) {
+                                    return initializeTerm(workingDirectory);
+                                },
+                                [this] { return terminalSignature(); },
+                                this))
+    , m_terminalList(new TerminalListModel(this))
+    , m_findInTerminals(nullptr)
+    , m_colorSchemeCatalog(new ColorSchemeCatalog(this))
+    , m_session(new TerminalSession(this))
+    , m_fontChangeTimer(nullptr)
+    , m_hibernationTimer(nullptr)
+    , m_hibernateAfterMs(0)
+    , m_openWhenResolved(false)
+    , m_firstPaintPending(true)
+    , m_suspendHiddenTabs(true)
+    , m_sessionEnabled(true)
 {
     QCoreApplication::setOrganizationName("TermPlugin");
     QCoreApplication::setOrganizationDomain("TermPlugin");
 
+    setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(this, &QWidget::customContextMenuRequested,
+            this, &TerminalContainer::contextMenuRequested);
+
+    connect(m_fileResolver, &QFutureWatcher<QString>::finished,
+            this, &TerminalContainer::fileResolved);
+    connect(Core::EditorManager::instance(), &Core::EditorManager::editorsClosed,
+            this, &TerminalContainer::scrollbackEditorsClosed);
+
+    // The output pane creates this widget during IDE startup. Keep it cheap,
+    // everything else is set up by initialize() once the pane is shown.
+    m_placeholder = new QWidget(this);
+
+    m_layout = new QVBoxLayout;
+    m_layout->setContentsMargins(0, 0, 0, 0);
+    m_layout->setSpacing(0);
+    m_layout->addWidget(m_placeholder);
+    setLayout(m_layout);
+
+    StartupTiming::mark("TerminalContainer created");
+}
+
+bool TerminalContainer::isInitialized() const
+{
+    return m_tabWidget;
+}
+
+// Containers that are not part of the Qt Creator session neither restore
+// nor save terminals. Has to be called before initialize().
+void TerminalContainer::setSessionEnabled(bool enabled)
+{
+    QTC_CHECK(!m_tabWidget);
+    m_sessionEnabled = enabled;
+}
+
+void TerminalContainer::initialize()
+{
+    if (m_tabWidget)
+        return;
+
+    StartupTiming::mark("Terminal pane first shown");
+
     // Try to get the saved color scheme. If it doesn't exist, set the default and
     // update the saved scheme. If it does exist, use that to set the terminal's scheme.
-    QSettings settings;
-    QString savedColorScheme = settings.value("colorScheme").toString();
-    bool hideTabs = settings.value("hideTabs", true).toBool();
+    TerminalSettings *settings = TerminalSettings::instance();
+    QString savedColorScheme = settings->value("colorScheme").toString();
+    bool hideTabs = settings->value("hideTabs", true).toBool();
     if (savedColorScheme.isEmpty()) {
 #if defined(Q_OS_LINUX)
         m_currentColorScheme = "DarkPastels";
@@ -67,39 +168,72 @@ TerminalContainer::TerminalContainer(QWidget *parent, QComboBox *m_toolbarTermin
 #else
         m_currentColorScheme = "BlackOnLightYellow";
 #endif
-        settings.setValue("colorScheme", m_currentColorScheme);
+        settings->setValue("colorScheme", m_currentColorScheme);
     } else {
         m_currentColorScheme = savedColorScheme;
     }
 
-    if (!settings.contains("terminalFont"))
-        settings.setValue("terminalFont", TextEditor::TextEditorSettings::instance()->fontSettings().font());
+    if (!settings->contains("terminalFont"))
+        settings->setValue("terminalFont", TextEditor::TextEditorSettings::instance()->fontSettings().font());
+    m_terminalFont = settings->value("terminalFont").value<QFont>();
 
-    setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(this, &QWidget::customContextMenuRequested,
-            this, &TerminalContainer::contextMenuRequested);
+    // Zoom steps only change m_terminalFont, the terminals are updated once
+    // the steps stop coming.
+    m_fontChangeTimer = new QTimer(this);
+    m_fontChangeTimer->setSingleShot(true);
+    m_fontChangeTimer->setInterval(100);
+    connect(m_fontChangeTimer, &QTimer::timeout, this, &TerminalContainer::applyFontChange);
+
+    m_fileIndex = new ProjectFileIndex(this);
 
     m_tabWidget = new QTabWidget(this);
-    m_tabWidget->addTab(initializeTerm(), tr("terminal"));
+
+    // The tabs follow the terminal list, which is shared with the toolbar.
+    connect(m_terminalList, &QAbstractItemModel::rowsInserted,
+            this, &TerminalContainer::terminalsInserted);
+    connect(m_terminalList, &QAbstractItemModel::rowsRemoved,
+            this, &TerminalContainer::terminalsRemoved);
+    connect(m_terminalList, &QAbstractItemModel::rowsMoved,
+            this, &TerminalContainer::terminalsMoved);
+    connect(m_terminalList, &QAbstractItemModel::dataChanged,
+            this, &TerminalContainer::terminalsChanged);
+
+    const int restoredIndex = restoreTerminals();
     m_tabWidget->setDocumentMode(true);
     m_tabWidget->setTabsClosable(true);
     m_tabWidget->setMovable(true);
     m_tabWidget->tabBar()->setHidden(hideTabs);
 
+    connect(m_tabWidget->tabBar(), &QTabBar::tabMoved, this, [this](int from, int to) {
+        // Tabs dragged by the user have to be moved in the list as well.
+        if (m_terminalList->terminal(to) != m_tabWidget->widget(to))
+            m_terminalList->moveTerminal(from, to);
+    });
+
     connect(m_tabWidget, &QTabWidget::tabCloseRequested,
             this, &TerminalContainer::closeTerminalId);
 
     connect(m_tabWidget, &QTabWidget::currentChanged,
             this, &TerminalContainer::currentTabChanged);
+    m_tabWidget->setCurrentIndex(restoredIndex);
+
+    if (m_sessionEnabled) {
+        connect(ProjectExplorer::SessionManager::instance(),
+                &ProjectExplorer::SessionManager::aboutToSaveSession,
+                this, &TerminalContainer::saveSession);
+        // Also emitted for the session restored at startup, which may come
+        // after the pane has been shown.
+        connect(ProjectExplorer::SessionManager::instance(),
+                &ProjectExplorer::SessionManager::sessionLoaded,
+                this, &TerminalContainer::sessionLoaded);
+    }
 
     connect(m_tabWidget, &QTabWidget::tabBarDoubleClicked,
             this, &TerminalContainer::tabBarDoubleClick);
 
-    m_layout = new QVBoxLayout;
-    m_layout->setContentsMargins(0, 0, 0, 0);
-    m_layout->setSpacing(0);
-    m_layout->addWidget(m_tabWidget);
-    setLayout(m_layout);
+    m_layout->replaceWidget(m_placeholder, m_tabWidget);
+    delete m_placeholder;
+    m_placeholder = nullptr;
 
     m_openSelection = new QAction("Open Selected File", this);
     addAction(m_openSelection);
@@ -108,6 +242,15 @@ TerminalContainer::TerminalContainer(QWidget *parent, QComboBox *m_toolbarTermin
     m_openSelection->setShortcutContext(Qt::ShortcutContext::WidgetWithChildrenShortcut);
     connect(m_openSelection, &QAction::triggered, this, &TerminalContainer::openSelectedFile);
 
+    // Menu entry for m_openSelection, only shown once the selection has been
+    // resolved to an existing file.
+    m_openResolvedFile = new QAction(this);
+    m_openResolvedFile->setShortcut(m_openSelection->shortcut());
+    m_openResolvedFile->setShortcutVisibleInContextMenu(true);
+    m_openResolvedFile->setShortcutContext(Qt::ShortcutContext::WidgetShortcut);
+    m_openResolvedFile->setVisible(false);
+    connect(m_openResolvedFile, &QAction::triggered, this, &TerminalContainer::openSelectedFile);
+
     m_showHideTabs = new QAction(this);
     m_showHideTabs->setText(hideTabs ? tr("Show Tabs") : tr("Hide Tabs"));
     connect(m_showHideTabs, &QAction::triggered, this, &TerminalContainer::toggleShowTabs);
@@ -126,6 +269,20 @@ TerminalContainer::TerminalContainer(QWidget *parent, QComboBox *m_toolbarTermin
     m_paste->setShortcutContext(Qt::ShortcutContext::WidgetWithChildrenShortcut);
     connect(m_paste, &QAction::triggered, this, &TerminalContainer::pasteInvoked);
 
+    m_saveScrollback = new QAction("Save Scrollback As...", this);
+    connect(m_saveScrollback, &QAction::triggered, this, &TerminalContainer::saveScrollback);
+
+    m_openScrollback = new QAction("Open Scrollback in Editor", this);
+    connect(m_openScrollback, &QAction::triggered, this, &TerminalContainer::openScrollbackInEditor);
+
+    m_logOutput = new QAction("Log Output to File", this);
+    m_logOutput->setCheckable(true);
+    connect(m_logOutput, &QAction::triggered, this, &TerminalContainer::setOutputLogged);
+
+    m_parseDiagnostics = new QAction("Show Build Issues in Issues Pane", this);
+    m_parseDiagnostics->setCheckable(true);
+    connect(m_parseDiagnostics, &QAction::triggered, this, &TerminalContainer::setDiagnosticsParsed);
+
     m_increaseFont = new QAction("Increase Font", this);
     addAction(m_increaseFont);
     m_increaseFont->setShortcut(QKeySequence(tr("Ctrl++")));
@@ -194,47 +351,262 @@ TerminalContainer::TerminalContainer(QWidget *parent, QComboBox *m_toolbarTermin
     m_closeAllTerminals->setShortcutContext(Qt::ShortcutContext::WidgetWithChildrenShortcut);
     connect(m_closeAllTerminals, &QAction::triggered, this, &TerminalContainer::closeAllTerminals);
 
+    m_findInAllTerminals = new QAction("Find in All Terminals...", this);
+    addAction(m_findInAllTerminals);
+    m_findInAllTerminals->setShortcut(QKeySequence(tr("Ctrl+Alt+F")));
+    m_findInAllTerminals->setShortcutVisibleInContextMenu(true);
+    m_findInAllTerminals->setShortcutContext(Qt::ShortcutContext::WidgetWithChildrenShortcut);
+    connect(m_findInAllTerminals, &QAction::triggered, this, &TerminalContainer::findInAllTerminals);
+
+    m_measureInputLatency = new QAction("Measure Input Latency...", this);
+    connect(m_measureInputLatency, &QAction::triggered, this, &TerminalContainer::measureInputLatency);
+
+    // Reading the available color schemes scans the scheme directories,
+    // only do that once somebody actually looks at them.
     m_colorSchemes = new QMenu("Color Schemes", this);
-    fillColorSchemeMenu();
+    connect(m_colorSchemes, &QMenu::aboutToShow, this, [this] {
+        if (m_colorSchemes->isEmpty())
+            fillColorSchemeMenu();
+    });
+    connect(m_colorSchemeCatalog, &ColorSchemeCatalog::schemesChanged,
+            m_colorSchemes, &QMenu::clear);
+
     setTabActions();
-    notifyTabsUpdated();
+
+    m_shellPool->setSize(settings->value("shellPoolSize", 1).toInt());
+    m_suspendHiddenTabs = settings->value("suspendHiddenTabs", true).toBool();
+    m_hibernationTimer = new QTimer(this);
+    connect(m_hibernationTimer, &QTimer::timeout, this, &TerminalContainer::hibernateIdleTerminals);
+    setHibernationDelay(settings->value("hibernateAfter", 30 * 60).toInt());
+    ScrollbackStore::setTotalBudget(settings->value("scrollbackTotalBudget",
+                                                    1024LL * 1024 * 1024).toLongLong());
+    connect(settings, &TerminalSettings::changed, this, &TerminalContainer::settingChanged);
+
+    termWidget()->installEventFilter(this);
+    StartupTiming::mark("First shell started");
+
+    emit termWidgetChanged(termWidget());
+}
+
+void TerminalContainer::settingChanged(const QString &key, const QVariant &value)
+{
+    if (key == "shellPoolSize") {
+        m_shellPool->setSize(value.toInt());
+    } else if (key == "suspendHiddenTabs") {
+        m_suspendHiddenTabs = value.toBool();
+        updateRenderSuspension();
+    } else if (key == "scrollbackTotalBudget") {
+        ScrollbackStore::setTotalBudget(value.toLongLong());
+    } else if (key == "hibernateAfter") {
+        setHibernationDelay(value.toInt());
+    }
+}
+
+void TerminalContainer::showEvent(QShowEvent *event)
+{
+    initialize();
+    QWidget::showEvent(event);
+}
+
+void TerminalContainer::focusInEvent(QFocusEvent *event)
+{
+    initialize();
+    QWidget::focusInEvent(event);
+    termWidget()->setFocus(event->reason());
+}
+
+bool TerminalContainer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (m_firstPaintPending && event->type() == QEvent::Paint) {
+        m_firstPaintPending = false;
+        watched->removeEventFilter(this);
+        StartupTiming::mark("First terminal painted");
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+TerminalContainer::~TerminalContainer()
+{
+    // The resolvers read from m_fileIndex, which is about to go away.
+    m_fileResolver->cancel();
+    m_fileResolver->waitForFinished();
+    qDeleteAll(findChildren<HotspotDetector *>());
+
+    for (const QString &fileName : qAsConst(m_scrollbackFiles))
+        QFile::remove(fileName);
+}
+
+static Utils::Environment terminalEnvironment()
+{
+    Utils::Environment env = Utils::Environment::systemEnvironment();
+    env.set("TERM_PROGRAM", QString("qtermwidget5"));
+    env.set("TERM", QString("xterm-256color"));
+    env.set("QTCREATOR_PID", QString("%1").arg(QCoreApplication::applicationPid()));
+    return env;
+}
+
+QStringList TerminalContainer::shellEnvironment()
+{
+    return terminalEnvironment().toStringList();
 }
 
-QTermWidget* TerminalContainer::initializeTerm(const QString & workingDirectory)
+QTermWidget* TerminalContainer::initializeTerm(const QString & workingDirectory, bool startShell)
 {
     QTermWidget *termWidget = new QTermWidget(0, this);
     termWidget->setWindowTitle(tr("Terminal"));
     termWidget->setWindowIcon(QIcon());
     termWidget->setScrollBarPosition(QTermWidget::ScrollBarRight);
 
-    termWidget->setColorScheme(m_currentColorScheme);
+    termWidget->setColorScheme(m_colorSchemeCatalog->terminalScheme(m_currentColorScheme));
 
-    QSettings settings;
-    QFont font = settings.value("terminalFont", QFont()).value<QFont>();
+    TerminalSettings *settings = TerminalSettings::instance();
+    QFont font = settings->value("terminalFont", QFont()).value<QFont>();
     termWidget->setTerminalFont(font);
     termWidget->setTerminalOpacity(1.0);
 
-    setFocusProxy(termWidget);
-
-    connect(termWidget, &QTermWidget::copyAvailable, this, &TerminalContainer::copyAvailable);
-    connect(termWidget, &QTermWidget::finished, this, &TerminalContainer::finished);
-    connect(termWidget, &QTermWidget::urlActivated, this, &TerminalContainer::urlActivated);
+    // The widget keeps a bounded history in memory, the full output goes
+    // to the scrollback store, which spills it to disk.
+    const int historyLines = settings->value("historyLines", 10000).toInt();
+    termWidget->setHistorySize(historyLines);
+    auto scrollback = new ScrollbackStore(termWidget);
+    scrollback->setBudget(settings->value("scrollbackBudget", 64 * 1024 * 1024).toLongLong());
 
     termWidget->setWorkingDirectory(workingDirectory.isEmpty() ? QDir::homePath()
                                                                : workingDirectory);
 
-    Utils::Environment env = Utils::Environment::systemEnvironment();
-    env.set("TERM_PROGRAM", QString("qtermwidget5"));
-    env.set("TERM", QString("xterm-256color"));
-    env.set("QTCREATOR_PID", QString("%1").arg(QCoreApplication::applicationPid()));
-    termWidget->setEnvironment(env.toStringList());
-    termWidget->startShellProgram();
+    termWidget->setEnvironment(terminalEnvironment().toStringList());
+    if (startShell)
+        PtyChannel::startShellProgram(termWidget, terminalEnvironment().toStringList());
     termWidget->setBlinkingCursor(true);
 //  termWidget->setConfirmMultilinePaste(false);
 
+    auto throttle = new RenderThrottle(termWidget);
+    throttle->setFloodThreshold(settings->value("floodThreshold", 4 * 1024 * 1024).toLongLong());
+    throttle->setFloodFrameRate(settings->value("floodFrameRate", 30).toInt());
+
+    new PerfCounters(termWidget);
+    new Hibernator(termWidget, historyLines);
+
+    return termWidget;
+}
+
+QTermWidget *TerminalContainer::acquireTerm(const QString &workingDirectory)
+{
+    QTermWidget *termWidget = m_shellPool->take(workingDirectory.isEmpty() ? QDir::homePath()
+                                                                           : workingDirectory);
+    if (!termWidget)
+        termWidget = initializeTerm(workingDirectory);
+
+    setupTerm(termWidget);
     return termWidget;
 }
 
+void TerminalContainer::setupTerm(QTermWidget *termWidget)
+{
+    setFocusProxy(termWidget);
+
+    connect(RenderThrottle::forTerminal(termWidget), &RenderThrottle::floodModeChanged,
+            this, [this, termWidget](bool flooding) {
+        const int index = m_tabWidget->indexOf(termWidget);
+        if (index < 0)
+            return;
+
+        const qint64 skipped = RenderThrottle::forTerminal(termWidget)->skippedFrames();
+        m_tabWidget->setTabToolTip(index, flooding
+                ? tr("High output rate, repaints are limited")
+                : tr("%n frame(s) skipped during high output rate", nullptr, int(skipped)));
+    });
+
+    // A zoom step may still be pending, the terminal catches up with it
+    // when it becomes current.
+    m_staleAppearance[termWidget] |= FontStale;
+    connect(termWidget, &QObject::destroyed, this, [this, termWidget] {
+        m_staleAppearance.remove(termWidget);
+    });
+    connect(termWidget, &QTermWidget::copyAvailable, this, &TerminalContainer::copyAvailable);
+    connect(termWidget, &QTermWidget::finished, this, &TerminalContainer::finished);
+    connect(termWidget, &QTermWidget::urlActivated, this, &TerminalContainer::urlActivated);
+
+    auto hotspots = new HotspotDetector(termWidget, m_fileIndex);
+    connect(hotspots, &HotspotDetector::activated,
+            this, [](const Utils::FilePath &file, int line, int column) {
+        Core::EditorManager::openEditorAt(Utils::Link(file, line, column > 0 ? column - 1 : 0));
+    });
+
+    if (m_sessionEnabled)
+        m_session->watch(termWidget);
+}
+
+int TerminalContainer::restoreTerminals()
+{
+    int currentIndex = 0;
+    QVector<TerminalSession::Tab> tabs;
+    if (m_sessionEnabled)
+        tabs = m_session->load(ProjectExplorer::SessionManager::activeSession(), &currentIndex);
+
+    if (tabs.isEmpty()) {
+        m_terminalList->insertTerminal(0, acquireTerm(), tr("terminal"));
+        return 0;
+    }
+
+    // The shells of restored terminals are only started when their tab is
+    // activated, see currentTabChanged().
+    for (int i = 0; i < tabs.count(); ++i) {
+        const QString &workingDirectory = tabs.at(i).workingDirectory;
+        QTermWidget *termWidget = initializeTerm(QDir(workingDirectory).exists() ? workingDirectory
+                                                                                 : QString(),
+                                                 false);
+        m_session->adopt(i, termWidget);
+        setupTerm(termWidget);
+        m_terminalList->insertTerminal(i, termWidget, tabs.at(i).name);
+    }
+
+    QTermWidget *current = m_terminalList->terminal(currentIndex);
+    m_session->start(current, terminalEnvironment().toStringList());
+    setFocusProxy(current);
+    return currentIndex;
+}
+
+void TerminalContainer::saveSession()
+{
+    // Saved with the session the tabs belong to, which is not the active
+    // one while Qt Creator switches sessions.
+    m_session->save(m_terminalList, m_tabWidget->currentIndex());
+}
+
+void TerminalContainer::sessionLoaded(const QString &session)
+{
+    if (session == m_session->sessionName())
+        return;
+
+    // The tabs of the previous session go with it.
+    saveSession();
+
+    int currentIndex = 0;
+    {
+        // Only the current terminal of the new session is started.
+        const QSignalBlocker blocker(m_tabWidget);
+        for (int i = m_tabWidget->count(); i > 0; i--) {
+            m_tabWidget->widget(i - 1)->deleteLater();
+            m_terminalList->removeTerminal(i - 1);
+        }
+        currentIndex = restoreTerminals();
+        m_tabWidget->setCurrentIndex(currentIndex);
+    }
+    currentTabChanged(currentIndex);
+    setTabActions();
+}
+
+QByteArray TerminalContainer::terminalSignature() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(terminalEnvironment().toStringList().join('\n').toUtf8());
+    hash.addData(TerminalSettings::instance()->value("terminalFont", QFont()).value<QFont>().toString().toUtf8());
+    hash.addData(m_currentColorScheme.toUtf8());
+    hash.addData(TerminalSettings::instance()->value("ptyIoThread", false).toBool() ? "pty" : "");
+    return hash.result();
+}
+
 void TerminalContainer::setTabActions()
 {
     bool enable = m_tabWidget->count() > 1;
@@ -247,35 +619,37 @@ void TerminalContainer::setTabActions()
 
 void TerminalContainer::closeAllTerminals()
 {
+    initialize();
+
     for (int i = m_tabWidget->count(); i > 0; i--)
     {
         m_tabWidget->widget(i-1)->deleteLater();
-        m_tabWidget->removeTab(i-1);
+        m_terminalList->removeTerminal(i-1);
     }
 
     createTerminal();
     setTabActions();
-    notifyTabsUpdated();
 }
 
 void TerminalContainer::closeCurrentTerminal()
 {
+    initialize();
+
     if (m_tabWidget->currentIndex() < 0)
         return;
 
-    m_tabWidget->removeTab(m_tabWidget->currentIndex());
+    m_terminalList->removeTerminal(m_tabWidget->currentIndex());
 
     if (m_tabWidget->count() == 0)
         createTerminal();
 
     setTabActions();
-    notifyTabsUpdated();
 }
 
 void TerminalContainer::closeTerminalId(int index)
 {
     m_tabWidget->widget(index)->deleteLater();
-    m_tabWidget->removeTab(index);
+    m_terminalList->removeTerminal(index);
 
     if (m_tabWidget->count() == 0)
         createTerminal();
@@ -283,7 +657,6 @@ void TerminalContainer::closeTerminalId(int index)
     m_tabWidget->setFocus();
     m_tabWidget->currentWidget()->setFocus();
     setTabActions();
-    notifyTabsUpdated();
 }
 
 void TerminalContainer::currentTabChanged(int index)
@@ -291,72 +664,207 @@ void TerminalContainer::currentTabChanged(int index)
     if (index <0 || index >= m_tabWidget->count())
         return;
 
-    notifyTabsUpdated();
+    cancelFileResolution();
+    m_resolvedFile.clear();
+
+    QTermWidget *terminal = static_cast<QTermWidget *>(m_tabWidget->widget(index));
+    if (m_session->isPending(terminal))
+        m_session->start(terminal, terminalEnvironment().toStringList());
+    if (Hibernator *hibernator = Hibernator::forTerminal(terminal))
+        hibernator->wake();
+
+    applyAppearance(terminal);
+    updateRenderSuspension();
+
+    m_toolbarTerminalsComboBox->setCurrentIndex(index);
     emit termWidgetChanged(termWidget());
 }
 
+void TerminalContainer::updateRenderSuspension()
+{
+    const int current = m_tabWidget->currentIndex();
+
+    for (int i = 0; i < m_tabWidget->count(); i++) {
+        QTermWidget *term = static_cast<QTermWidget *>(m_tabWidget->widget(i));
+        Hibernator *hibernator = Hibernator::forTerminal(term);
+        const bool hibernated = hibernator && hibernator->isHibernated();
+        if (RenderThrottle *throttle = RenderThrottle::forTerminal(term))
+            throttle->setSuspended((m_suspendHiddenTabs || hibernated) && i != current);
+    }
+}
+
+void TerminalContainer::setHibernationDelay(int seconds)
+{
+    m_hibernateAfterMs = qint64(qMax(0, seconds)) * 1000;
+    if (m_hibernateAfterMs == 0) {
+        m_hibernationTimer->stop();
+        return;
+    }
+
+    // Checking is cheap, but there is no point in doing it more than once
+    // a minute.
+    m_hibernationTimer->setInterval(int(qBound<qint64>(1000, m_hibernateAfterMs / 4, 60 * 1000)));
+    m_hibernationTimer->start();
+}
+
+void TerminalContainer::hibernateIdleTerminals()
+{
+    const int current = m_tabWidget->currentIndex();
+    bool changed = false;
+
+    for (int i = 0; i < m_tabWidget->count(); i++) {
+        QTermWidget *term = static_cast<QTermWidget *>(m_tabWidget->widget(i));
+        Hibernator *hibernator = Hibernator::forTerminal(term);
+        // Terminals of the session that were never shown have nothing to
+        // give back.
+        if (i == current || !hibernator || hibernator->isHibernated() || m_session->isPending(term)
+                || hibernator->idleMilliseconds() < m_hibernateAfterMs) {
+            continue;
+        }
+        hibernator->hibernate();
+        changed = true;
+    }
+
+    if (changed) {
+        Hibernator::releaseFreedMemory();
+        updateRenderSuspension();
+    }
+}
+
 void TerminalContainer::contextMenuRequested(const QPoint &point)
 {
     QMenu menu;
 
     fillContextMenu(&menu);
 
+    connect(&menu, &QMenu::aboutToShow, this, &TerminalContainer::contextMenuAboutToShow);
+    connect(&menu, &QMenu::aboutToHide, this, &TerminalContainer::contextMenuAboutToHide);
+
     menu.exec(mapToGlobal(point));
 }
 
-QFileInfo TerminalContainer::getSelectedFilePath()
+static void resolveSelectedFile(QFutureInterface<QString> &futureInterface,
+                                const QString &selectedText,
+                                const QString &workingDirectory,
+                                const ProjectFileIndex *fileIndex,
+                                ProjectExplorer::Project *project)
 {
-    QString selectedText = termWidget()->selectedText(false).trimmed();
     QFileInfo file(selectedText);
 
-    if (file.exists() && !file.isDir())
-        return file;
+    if (file.exists() && !file.isDir()) {
+        futureInterface.reportResult(file.canonicalFilePath());
+        return;
+    }
+
+    if (futureInterface.isCanceled())
+        return;
+
+    file = QFileInfo(QDir(workingDirectory), selectedText);
 
-    QString dir = termWidget()->workingDirectory();
-    file = QFileInfo(QDir(dir), selectedText);
+    if (file.exists() && !file.isDir()) {
+        futureInterface.reportResult(file.canonicalFilePath());
+        return;
+    }
+
+    if (futureInterface.isCanceled())
+        return;
 
-    if (file.exists() && !file.isDir())
-        return file;
+    const Utils::FilePath projectFile = fileIndex->findFile(selectedText, project);
 
-    ProjectExplorer::Project *project = ProjectExplorer::ProjectTree::currentProject();
+    if (!projectFile.isEmpty())
+        futureInterface.reportResult(projectFile.toString());
+}
 
-    if (!project)
-        return QFileInfo();
+void TerminalContainer::startFileResolution()
+{
+    cancelFileResolution();
+    m_resolvedFile.clear();
 
-    Utils::FilePaths fileList = project->files(ProjectExplorer::Project::AllFiles);
+    const QString selectedText = termWidget()->selectedText(false).trimmed();
+    if (selectedText.isEmpty())
+        return;
 
-    for (Utils::FilePath& projectsFile : fileList)
-        if (projectsFile.endsWith(selectedText))
-            return QFileInfo(projectsFile.toString());
+    // QTermWidget::workingDirectory() canonicalizes the shell's directory,
+    // which stats every path component. Leave that to the worker thread.
+#if defined(Q_OS_LINUX)
+    const QString workingDirectory = QString("/proc/%1/cwd").arg(PtyChannel::shellPid(termWidget()));
+#else
+    const QString workingDirectory = PtyChannel::workingDirectory(termWidget());
+#endif
 
-    for (ProjectExplorer::Project *nonCurrentProj : ProjectExplorer::SessionManager::projects())
-        if (project != nonCurrentProj)
-            for (Utils::FilePath& projectsFile : nonCurrentProj->files(ProjectExplorer::Project::AllFiles))
-                if (projectsFile.endsWith(selectedText))
-                    return QFileInfo(projectsFile.toString());
+    m_fileResolver->setFuture(Utils::runAsync(&resolveSelectedFile,
+                                              selectedText,
+                                              workingDirectory,
+                                              m_fileIndex,
+                                              ProjectExplorer::ProjectTree::currentProject()));
+}
 
-    return QFileInfo();
+void TerminalContainer::cancelFileResolution()
+{
+    if (m_fileResolver->isRunning())
+        m_fileResolver->cancel();
 }
 
-void TerminalContainer::fillContextMenu(QMenu *menu)
+void TerminalContainer::fileResolved()
 {
-    QFileInfo file = getSelectedFilePath();
+    const QFuture<QString> future = m_fileResolver->future();
+    if (future.isCanceled() || future.resultCount() == 0) {
+        m_openWhenResolved = false;
+        return;
+    }
+
+    m_resolvedFile = future.result();
+    m_openResolvedFile->setText("Open \"" + QFileInfo(m_resolvedFile).fileName() + "\"");
+    m_openResolvedFile->setVisible(true);
 
-    if (file.exists()) {
-        m_openSelection->setText("Open \"" + file.fileName() + "\"");
-        menu->addAction(m_openSelection);
-        menu->addSeparator();
+    if (m_openWhenResolved) {
+        m_openWhenResolved = false;
+        openSelectedFile();
     }
+}
+
+void TerminalContainer::contextMenuAboutToShow()
+{
+    // The selection is resolved in the background while the menu is open,
+    // the "Open" entry shows up as soon as a matching file is found.
+    m_openResolvedFile->setVisible(false);
+    startFileResolution();
+
+    const OutputLogger *logger = OutputLogger::forTerminal(termWidget());
+    m_logOutput->setChecked(logger);
+    m_logOutput->setToolTip(logger ? QDir::toNativeSeparators(logger->fileName()) : QString());
+    m_parseDiagnostics->setChecked(DiagnosticsParser::forTerminal(termWidget()));
+}
+
+void TerminalContainer::contextMenuAboutToHide()
+{
+    cancelFileResolution();
+}
+
+void TerminalContainer::fillContextMenu(QMenu *menu)
+{
+    initialize();
+
+    m_openResolvedFile->setVisible(false);
+    menu->addAction(m_openResolvedFile);
+    menu->addSeparator();
 
     menu->addAction(m_showHideTabs);
     menu->addMenu(m_colorSchemes);
     menu->addSeparator();
     menu->addAction(m_copy);
     menu->addAction(m_paste);
+    menu->addAction(m_saveScrollback);
+    menu->addAction(m_openScrollback);
+    menu->addAction(m_logOutput);
+    menu->addAction(m_parseDiagnostics);
     menu->addSeparator();
     menu->addAction(m_increaseFont);
     menu->addAction(m_decreaseFont);
     menu->addSeparator();
+    menu->addAction(m_findInAllTerminals);
+    menu->addAction(m_measureInputLatency);
+    menu->addSeparator();
     menu->addAction(m_newTerminal);
     menu->addAction(m_closeTerminal);
     menu->addAction(m_renameTerminal);
@@ -369,12 +877,24 @@ void TerminalContainer::fillContextMenu(QMenu *menu)
     menu->addAction(m_closeAllTerminals);
 }
 
+static QIcon colorSchemeIcon(const ColorSchemeCatalog::Palette &palette)
+{
+    if (!palette.isValid())
+        return QIcon();
+
+    QPixmap pixmap(16, 16);
+    pixmap.fill(palette.background);
+    QPainter painter(&pixmap);
+    painter.fillRect(3, 6, 10, 4, palette.foreground);
+    return QIcon(pixmap);
+}
+
 void TerminalContainer::fillColorSchemeMenu()
 {
-    QStringList schemes = termWidget()->availableColorSchemes();
-    schemes.sort();
-    for(QString &scheme : schemes) {
+    const QStringList schemes = m_colorSchemeCatalog->schemes();
+    for(const QString &scheme : schemes) {
         QAction *action = new QAction(scheme, m_colorSchemes);
+        action->setIcon(colorSchemeIcon(m_colorSchemeCatalog->palette(scheme)));
         if(scheme == m_currentColorScheme) {
             QFont font = action->font();
             font.setBold(true);
@@ -384,8 +904,7 @@ void TerminalContainer::fillColorSchemeMenu()
         connect(action, &QAction::triggered, this, [=] {
             m_currentColorScheme = scheme;
             setColorScheme(scheme);
-            QSettings settings;
-            settings.setValue("colorScheme", m_currentColorScheme);
+            TerminalSettings::instance()->setValue("colorScheme", m_currentColorScheme);
 
             for (QAction *listAction : m_colorSchemes->actions()) {
                 QFont font = listAction->font();
@@ -398,32 +917,54 @@ void TerminalContainer::fillColorSchemeMenu()
     }
 }
 
-void TerminalContainer::notifyTabsUpdated()
+void TerminalContainer::terminalsInserted(const QModelIndex &, int first, int last)
 {
-    QList<QString> tabs;
-    for (int i = 0; i < m_tabWidget->count(); i++)
-        tabs.append(m_tabWidget->tabText(i));
+    for (int row = first; row <= last; ++row)
+        m_tabWidget->insertTab(row, m_terminalList->terminal(row), m_terminalList->name(row));
+}
 
-    emit tabsUpdated(m_tabWidget->currentIndex(), tabs);
+void TerminalContainer::terminalsRemoved(const QModelIndex &, int first, int last)
+{
+    for (int row = last; row >= first; --row)
+        m_tabWidget->removeTab(row);
 }
 
-void TerminalContainer::openSelectedFile()
+void TerminalContainer::terminalsMoved(const QModelIndex &, int start, int, const QModelIndex &, int row)
+{
+    const int to = row > start ? row - 1 : row;
+    if (m_tabWidget->widget(to) != m_terminalList->terminal(to))
+        m_tabWidget->tabBar()->moveTab(start, to);
+}
+
+void TerminalContainer::terminalsChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
-    QFileInfo file = getSelectedFilePath();
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        const QString name = m_terminalList->name(row);
+        if (m_tabWidget->tabText(row) != name)
+            m_tabWidget->setTabText(row, name);
+    }
+}
 
-    if (file.exists()) {
-        Core::ICore::openFiles(Utils::transform(QStringList() << file.absoluteFilePath(), &Utils::FilePath::fromString),
-                               Core::ICore::SwitchMode);
+void TerminalContainer::openSelectedFile()
+{
+    if (m_resolvedFile.isEmpty()) {
+        m_openWhenResolved = true;
+        startFileResolution();
+        return;
     }
+
+    Core::ICore::openFiles(Utils::transform(QStringList() << m_resolvedFile, &Utils::FilePath::fromString),
+                           Core::ICore::SwitchMode);
 }
 
 void TerminalContainer::toggleShowTabs()
 {
+    initialize();
+
     bool hide = !m_tabWidget->tabBar()->isHidden();
     m_tabWidget->tabBar()->setHidden(hide);
     m_showHideTabs->setText(hide ? tr("Show Tabs") : tr("Hide Tabs"));
-    QSettings settings;
-    settings.setValue("hideTabs", hide);
+    TerminalSettings::instance()->setValue("hideTabs", hide);
 }
 
 void TerminalContainer::copyInvoked()
@@ -431,14 +972,162 @@ void TerminalContainer::copyInvoked()
     termWidget()->copyClipboard();
 }
 
+void TerminalContainer::saveScrollback()
+{
+    QTermWidget *terminal = termWidget();
+    ScrollbackStore *store = ScrollbackStore::forTerminal(terminal);
+    if (!store)
+        return;
+
+    const QString plainFilter = tr("Plain Text (*.txt)");
+    const QString escapesFilter = tr("Text with Colors (*.ansi *.log)");
+    QString selectedFilter = plainFilter;
+    const QString fileName = QFileDialog::getSaveFileName(
+                Core::ICore::dialogParent(), tr("Save Scrollback As"),
+                QDir(PtyChannel::workingDirectory(terminal)).filePath("scrollback.txt"),
+                plainFilter + ";;" + escapesFilter, &selectedFilter);
+    if (fileName.isEmpty())
+        return;
+
+    auto exporter = new ScrollbackExport(store->snapshot(), fileName,
+                                         selectedFilter == escapesFilter ? ScrollbackExport::EscapeSequences
+                                                                         : ScrollbackExport::PlainText,
+                                         this);
+    connect(exporter, &ScrollbackExport::finished, this, [exporter](bool success) {
+        if (!success && !exporter->isCanceled()) {
+            QMessageBox::warning(Core::ICore::dialogParent(), tr("Save Scrollback As"),
+                                 tr("Cannot save the scrollback to %1: %2")
+                                 .arg(QDir::toNativeSeparators(exporter->fileName()),
+                                      exporter->errorString()));
+        }
+        exporter->deleteLater();
+    });
+    exporter->start(tr("Saving scrollback"));
+}
+
+void TerminalContainer::openScrollbackInEditor()
+{
+    QTermWidget *terminal = termWidget();
+    ScrollbackStore *store = ScrollbackStore::forTerminal(terminal);
+    if (!store)
+        return;
+
+    QTemporaryFile file(QDir::tempPath() + "/terminal-scrollback-XXXXXX.txt");
+    file.setAutoRemove(false);
+    if (!file.open()) {
+        QMessageBox::warning(Core::ICore::dialogParent(), tr("Open Scrollback in Editor"),
+                             tr("Cannot create a temporary file: %1").arg(file.errorString()));
+        return;
+    }
+    file.close();
+    // Removed once its editor is closed, see scrollbackEditorsClosed().
+    m_scrollbackFiles.append(file.fileName());
+
+    auto exporter = new ScrollbackExport(store->snapshot(), file.fileName(),
+                                         ScrollbackExport::PlainText, this);
+    connect(exporter, &ScrollbackExport::finished, this, [this, exporter](bool success) {
+        if (success) {
+            Core::ICore::openFiles({Utils::FilePath::fromString(exporter->fileName())},
+                                   Core::ICore::SwitchMode);
+        } else {
+            m_scrollbackFiles.removeOne(exporter->fileName());
+            QFile::remove(exporter->fileName());
+            if (!exporter->isCanceled()) {
+                QMessageBox::warning(Core::ICore::dialogParent(), tr("Open Scrollback in Editor"),
+                                     tr("Cannot write the scrollback: %1").arg(exporter->errorString()));
+            }
+        }
+        exporter->deleteLater();
+    });
+    exporter->start(tr("Exporting scrollback"));
+}
+
+void TerminalContainer::scrollbackEditorsClosed(const QList<Core::IEditor *> &editors)
+{
+    for (Core::IEditor *editor : editors) {
+        const Utils::FilePath filePath = editor->document()->filePath();
+        // The document may still be open in another split.
+        if (!m_scrollbackFiles.contains(filePath.toString())
+                || Core::DocumentModel::documentForFilePath(filePath)) {
+            continue;
+        }
+        m_scrollbackFiles.removeOne(filePath.toString());
+        QFile::remove(filePath.toString());
+    }
+}
+
+void TerminalContainer::setOutputLogged(bool logged)
+{
+    QTermWidget *terminal = termWidget();
+    const int row = m_terminalList->indexOf(terminal);
+    OutputLogger *logger = OutputLogger::forTerminal(terminal);
+
+    if (!logged) {
+        delete logger;
+        m_terminalList->setLogSize(row, -1);
+        return;
+    }
+    if (logger)
+        return;
+
+    TerminalSettings *settings = TerminalSettings::instance();
+    const QString directory = settings->value("logDirectory", OutputLogger::defaultDirectory()).toString();
+    QString baseName = m_terminalList->name(row);
+    baseName.replace(QRegularExpression("[^A-Za-z0-9._-]"), "_");
+    // Tabs may have the same name, the shell's pid tells them apart.
+    const QString stem = QDir(directory).filePath(
+                QString("%1-%2-%3").arg(baseName,
+                                        QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"))
+                .arg(PtyChannel::shellPid(terminal)));
+    QString fileName = stem + ".log";
+    for (int i = 1; QFileInfo::exists(fileName); ++i)
+        fileName = QString("%1-%2.log").arg(stem).arg(i);
+
+    OutputLogger::Rotation rotation;
+    rotation.maxFileBytes = settings->value("logMaxFileSize", 64 * 1024 * 1024).toLongLong();
+    rotation.keepFiles = settings->value("logKeepFiles", 5).toInt();
+    rotation.compress = settings->value("logCompress", true).toBool();
+
+    logger = new OutputLogger(terminal, fileName, rotation);
+    m_terminalList->setLogSize(row, 0);
+    connect(logger, &OutputLogger::bytesWrittenChanged, this, [this, terminal](qint64 bytes) {
+        const int row = m_terminalList->indexOf(terminal);
+        if (row >= 0)
+            m_terminalList->setLogSize(row, bytes);
+    });
+}
+
+void TerminalContainer::setDiagnosticsParsed(bool parsed)
+{
+    QTermWidget *terminal = termWidget();
+    DiagnosticsParser *parser = DiagnosticsParser::forTerminal(terminal);
+
+    if (!parsed)
+        delete parser;
+    else if (!parser)
+        new DiagnosticsParser(terminal);
+}
+
 void TerminalContainer::pasteInvoked()
 {
-    termWidget()->pasteClipboard();
+    QTermWidget *terminal = termWidget();
+    const QString text = QGuiApplication::clipboard()->text();
+
+    // Large pastes are fed to the PTY as the program reads them.
+    if (text.size() >= PasteStreamer::streamingThreshold || PasteStreamer::forTerminal(terminal))
+        PasteStreamer::paste(terminal, text);
+    else
+        terminal->pasteClipboard();
 }
 
 void TerminalContainer::copyAvailable(bool available)
 {
     m_copy->setEnabled(available);
+
+    // The selection changed, whatever was resolved for it is stale now.
+    cancelFileResolution();
+    m_resolvedFile.clear();
+    m_openResolvedFile->setVisible(false);
 }
 
 void TerminalContainer::urlActivated(const QUrl& url, bool)
@@ -449,42 +1138,55 @@ void TerminalContainer::urlActivated(const QUrl& url, bool)
 
 void TerminalContainer::increaseFont()
 {
-    QFont termFont = termWidget()->getTerminalFont();
+    initialize();
 
-    if (termFont.pointSize() == -1 || termFont.pointSize() >= 32)
+    if (m_terminalFont.pointSize() == -1 || m_terminalFont.pointSize() >= 32)
         return;
 
-    termFont.setPointSize(termFont.pointSize() + 1);
-
-    for (int i = 0; i < m_tabWidget->count(); i++) {
-        QTermWidget *term = static_cast<QTermWidget *>(m_tabWidget->widget(i));
-        term->setTerminalFont(termFont);
-    }
-
-    QSettings settings;
-    settings.setValue("terminalFont", termFont);
+    m_terminalFont.setPointSize(m_terminalFont.pointSize() + 1);
+    m_fontChangeTimer->start();
 }
 
 void TerminalContainer::decreaseFont()
 {
-    QFont termFont = termWidget()->getTerminalFont();
+    initialize();
 
-    if (termFont.pointSize() <= 6)
+    if (m_terminalFont.pointSize() <= 6)
         return;
 
-    termFont.setPointSize(termFont.pointSize() - 1);
+    m_terminalFont.setPointSize(m_terminalFont.pointSize() - 1);
+    m_fontChangeTimer->start();
+}
 
-    for (int i = 0; i < m_tabWidget->count(); i++) {
-        QTermWidget *term = static_cast<QTermWidget *>(m_tabWidget->widget(i));
-        term->setTerminalFont(termFont);
-    }
+void TerminalContainer::applyFontChange()
+{
+    TerminalSettings::instance()->setValue("terminalFont", m_terminalFont);
+    markAppearanceStale(FontStale);
+}
+
+void TerminalContainer::markAppearanceStale(int what)
+{
+    for (int i = 0; i < m_tabWidget->count(); i++)
+        m_staleAppearance[static_cast<QTermWidget *>(m_tabWidget->widget(i))] |= what;
+
+    // Hidden tabs catch up once they become current.
+    applyAppearance(static_cast<QTermWidget *>(m_tabWidget->currentWidget()));
+}
+
+void TerminalContainer::applyAppearance(QTermWidget *terminal)
+{
+    const int stale = m_staleAppearance.take(terminal);
 
-    QSettings settings;
-    settings.setValue("terminalFont", termFont);
+    if ((stale & FontStale) && terminal->getTerminalFont() != m_terminalFont)
+        terminal->setTerminalFont(m_terminalFont);
+    if (stale & ColorSchemeStale)
+        terminal->setColorScheme(m_colorSchemeCatalog->terminalScheme(m_currentColorScheme));
 }
 
 void TerminalContainer::closeTerminal()
 {
+    initialize();
+
     closeTerminalId(m_tabWidget->currentIndex());
 }
 
@@ -517,7 +1219,7 @@ void TerminalContainer::renameTerminal(int index)
         lineEdit = new QLineEdit(m_tabWidget);
         lineEdit->setGeometry(m_tabWidget->tabBar()->tabRect(index));
     }
-    lineEdit->setText(m_tabWidget->tabText(index));
+    lineEdit->setText(m_terminalList->name(index));
     lineEdit->selectAll();
     int lineEditWidth = lineEdit->size().width();
 
@@ -527,9 +1229,8 @@ void TerminalContainer::renameTerminal(int index)
         if (lineEdit->text().isEmpty())
             return;
 
-        m_tabWidget->setTabText(index, lineEdit->text());
+        m_terminalList->setName(index, lineEdit->text());
         m_tabWidget->currentWidget()->setFocus();
-        notifyTabsUpdated();
     });
 
     connect(lineEdit, &QLineEdit::editingFinished,
@@ -557,6 +1258,8 @@ void TerminalContainer::renameTerminal(int index)
 
 void TerminalContainer::createTerminal()
 {
+    initialize();
+
     QString path;
     int count = m_tabWidget->count();
     if (count == 0)
@@ -565,19 +1268,21 @@ void TerminalContainer::createTerminal()
     }
     else
     {
-        path = termWidget()->workingDirectory();
+        path = PtyChannel::workingDirectory(termWidget());
     }
-    int index = m_tabWidget->addTab(initializeTerm(path), "terminal");
+    int index = m_tabWidget->count();
+    m_terminalList->insertTerminal(index, acquireTerm(path), "terminal");
     m_tabWidget->setCurrentIndex(index);
     m_tabWidget->currentWidget()->setFocus();
     setTabActions();
-    notifyTabsUpdated();
 
     emit termWidgetChanged(termWidget());
 }
 
 void TerminalContainer::nextTerminal()
 {
+    initialize();
+
     if (m_tabWidget->count() <= 1)
         return;
 
@@ -588,13 +1293,14 @@ void TerminalContainer::nextTerminal()
 
     m_tabWidget->setCurrentIndex(nextIndex);
     m_tabWidget->currentWidget()->setFocus();
-    notifyTabsUpdated();
 
     emit termWidgetChanged(termWidget());
 }
 
 void TerminalContainer::prevTerminal()
 {
+    initialize();
+
     if (m_tabWidget->count() <= 1)
         return;
 
@@ -605,7 +1311,6 @@ void TerminalContainer::prevTerminal()
 
     m_tabWidget->setCurrentIndex(prevIndex);
     m_tabWidget->currentWidget()->setFocus();
-    notifyTabsUpdated();
 
     emit termWidgetChanged(termWidget());
 }
@@ -618,10 +1323,9 @@ void TerminalContainer::moveTerminalLeft()
     int currentIndex = m_tabWidget->currentIndex();
     int nextIndex = currentIndex ? currentIndex - 1 : m_tabWidget->count() - 1;
 
-    m_tabWidget->tabBar()->moveTab(currentIndex, nextIndex);
+    m_terminalList->moveTerminal(currentIndex, nextIndex);
     m_tabWidget->setCurrentIndex(nextIndex);
     m_tabWidget->currentWidget()->setFocus();
-    notifyTabsUpdated();
 }
 
 void TerminalContainer::moveTerminalRight()
@@ -632,20 +1336,99 @@ void TerminalContainer::moveTerminalRight()
     int currentIndex = m_tabWidget->currentIndex();
     int nextIndex = (currentIndex + 1 == m_tabWidget->count()) ? 0 : currentIndex + 1;
 
-    m_tabWidget->tabBar()->moveTab(currentIndex, nextIndex);
+    m_terminalList->moveTerminal(currentIndex, nextIndex);
     m_tabWidget->setCurrentIndex(nextIndex);
     m_tabWidget->currentWidget()->setFocus();
-    notifyTabsUpdated();
+}
+
+void TerminalContainer::showDiagnostics()
+{
+    initialize();
+
+    if (!m_diagnostics)
+        m_diagnostics = new TerminalDiagnostics(m_terminalList, this);
+    m_diagnostics->show();
+    m_diagnostics->raise();
+    m_diagnostics->activateWindow();
+}
+
+void TerminalContainer::measureInputLatency()
+{
+    initialize();
+
+    auto dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle(tr("Input Latency"));
+
+    // The probe terminal is set up like any other terminal, only the shell
+    // is replaced by an echo program.
+    QTermWidget *terminal = initializeTerm(QString(), false);
+    auto label = new QLabel(tr("Sending keystrokes..."), dialog);
+    label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Close, dialog);
+    connect(buttons, &QDialogButtonBox::rejected, dialog, &QDialog::reject);
+
+    auto layout = new QVBoxLayout(dialog);
+    layout->addWidget(terminal);
+    layout->addWidget(label);
+    layout->addWidget(buttons);
+    dialog->resize(600, 300);
+    dialog->show();
+
+    auto probe = new LatencyProbe(terminal, dialog);
+    connect(probe, &LatencyProbe::progress, label, [label](int done, int total) {
+        label->setText(tr("Sending keystrokes... %1/%2").arg(done).arg(total));
+    });
+    connect(probe, &LatencyProbe::finished, label, [label, probe] {
+        label->setText(probe->summary());
+    });
+    probe->start(shellEnvironment());
+}
+
+void TerminalContainer::findInAllTerminals()
+{
+    if (!m_findInTerminals) {
+        m_findInTerminals = new FindInTerminals(this);
+        connect(m_findInTerminals, &FindInTerminals::activated,
+                this, &TerminalContainer::showSearchHit);
+    }
+
+    if (!m_findInTerminals->askForQuery(this))
+        return;
+
+    QList<FindInTerminals::Target> terminals;
+    for (int i = 0; i < m_tabWidget->count(); ++i)
+        terminals.append({static_cast<QTermWidget *>(m_tabWidget->widget(i)), m_tabWidget->tabText(i)});
+    m_findInTerminals->start(terminals);
+}
+
+void TerminalContainer::showSearchHit(QTermWidget *terminal, qint64 line, int column, int length)
+{
+    const int index = m_tabWidget->indexOf(terminal);
+    if (index < 0)
+        return;
+
+    emit popupRequested();
+    setCurrentIndex(index);
+
+    int widgetColumn = 0;
+    const ScrollbackSnapshot snapshot = ScrollbackStore::forTerminal(terminal)->snapshot();
+    const int widgetLine = TerminalGeometry::widgetLine(terminal, snapshot, line, column, &widgetColumn);
+    if (widgetLine >= 0) {
+        TerminalGeometry::reveal(terminal, widgetLine, widgetColumn, length);
+    } else {
+        QToolTip::showText(terminal->mapToGlobal(terminal->rect().topRight()),
+                           tr("Line %1 is no longer shown in the terminal.").arg(line + 1),
+                           terminal);
+    }
 }
 
 void TerminalContainer::setColorScheme(const QString &scheme)
 {
+    initialize();
+
     m_currentColorScheme = scheme;
-    for (int i = 0; i < m_tabWidget->count(); i++) {
-        QTermWidget *widget =  static_cast<QTermWidget *>(m_tabWidget->widget(i));
-        if (widget)
-            widget->setColorScheme(m_currentColorScheme);
-    }
+    markAppearanceStale(ColorSchemeStale);
 }
 
 QString TerminalContainer::currentDocumentPath() const
@@ -660,14 +1443,23 @@ QString TerminalContainer::currentDocumentPath() const
 
 QTermWidget *TerminalContainer::termWidget()
 {
+    initialize();
+
     if (m_tabWidget->count() == 0)
         createTerminal();
 
     return static_cast<QTermWidget *>(m_tabWidget->currentWidget());
 }
 
+TerminalListModel *TerminalContainer::terminalList() const
+{
+    return m_terminalList;
+}
+
 void TerminalContainer::setCurrentIndex(int index)
 {
+    initialize();
+
     m_tabWidget->setCurrentIndex(index);
     m_tabWidget->currentWidget()->setFocus();
     emit termWidgetChanged(termWidget());
@@ -696,9 +1488,10 @@ TerminalWindow::TerminalWindow(QObject *parent)
 
     m_terminalsBox = new QComboBox();
     m_terminalsBox->setProperty("drawleftborder", true);
-    m_terminalsBox->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+    // Adjusting to the contents measures every item on each change.
+    m_terminalsBox->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+    m_terminalsBox->setMinimumContentsLength(20);
     m_terminalsBox->setMinimumWidth(200);
-    m_terminalsBox->addItem(tr("1: terminal"));
 
     m_addTerminal = new QToolButton();
     m_addTerminal->setIcon(Utils::Icons::FITTOVIEW_TOOLBAR.icon());
@@ -737,13 +1530,16 @@ QWidget *TerminalWindow::outputWidget(QWidget *parent)
         connect(m_terminalContainer, &TerminalContainer::finished,
                 this, &TerminalWindow::terminalFinished);
 
-        m_context->setWidget(m_terminalContainer->termWidget());
+        m_context->setWidget(m_terminalContainer);
         Core::ICore::addContextObject(m_context);
 
-        auto findSupport = new FindSupport(m_terminalContainer->termWidget());
+        // The first terminal only exists once the pane is shown, the find
+        // support picks it up through termWidgetChanged().
+        auto findSupport = new FindSupport;
         connect(m_terminalContainer, &TerminalContainer::termWidgetChanged,
                 findSupport, &FindSupport::setTerminal);
 
+        m_terminalsBox->setModel(m_terminalContainer->terminalList());
         connect(m_terminalsBox, QOverload<int>::of(&QComboBox::activated),
                 m_terminalContainer, &TerminalContainer::setCurrentIndex);
 
@@ -753,8 +1549,9 @@ QWidget *TerminalWindow::outputWidget(QWidget *parent)
         connect(m_removeTerminal, &QAbstractButton::clicked,
                 m_terminalContainer, &TerminalContainer::closeTerminal);
 
-        connect(m_terminalContainer, &TerminalContainer::tabsUpdated,
-                this, &TerminalWindow::tabsUpdated);
+        connect(m_terminalContainer, &TerminalContainer::popupRequested, this, [this] {
+            popup(Core::IOutputPane::ModeSwitch | Core::IOutputPane::WithFocus);
+        });
 
         connect(this, &TerminalWindow::zoomInRequested,
                 m_terminalContainer, &TerminalContainer::increaseFont);
@@ -767,7 +1564,17 @@ QWidget *TerminalWindow::outputWidget(QWidget *parent)
         agg->add(findSupport);
 
         QMenu *menu = new QMenu(m_settings);
-        m_terminalContainer->fillContextMenu(menu);
+        connect(menu, &QMenu::aboutToShow, m_terminalContainer, [this, menu] {
+            if (menu->isEmpty()) {
+                m_terminalContainer->fillContextMenu(menu);
+                menu->addSeparator();
+                menu->addAction(tr("Performance Diagnostics..."),
+                                m_terminalContainer, &TerminalContainer::showDiagnostics);
+            }
+            m_terminalContainer->contextMenuAboutToShow();
+        });
+        connect(menu, &QMenu::aboutToHide,
+                m_terminalContainer, &TerminalContainer::contextMenuAboutToHide);
         m_settings->setMenu(menu);
         m_settings->setPopupMode(QToolButton::InstantPopup);
     }
@@ -792,7 +1599,7 @@ int TerminalWindow::priorityInStatusBar() const
 
 void TerminalWindow::clearContents()
 {
-    if (!m_terminalContainer || !m_terminalContainer->termWidget())
+    if (!m_terminalContainer || !m_terminalContainer->isInitialized())
         return;
     QString cmd = "clear\n";
     m_terminalContainer->termWidget()->sendText(cmd);
@@ -809,16 +1616,6 @@ void TerminalWindow::sync()
     }
 }
 
-void TerminalWindow::tabsUpdated(int currentIndex, QList<QString> tabNames)
-{
-    m_terminalsBox->clear();
-
-    for(int i = 0; i < tabNames.count(); i++)
-        m_terminalsBox->addItem(QString("%1: %2").arg(QString::number(i + 1), tabNames[i]));
-
-    m_terminalsBox->setCurrentIndex(currentIndex);
-}
-
 
 void TerminalWindow::terminalFinished()
 {
@@ -827,14 +1624,14 @@ void TerminalWindow::terminalFinished()
 
 void TerminalWindow::setFocus()
 {
-    if (!m_terminalContainer || !m_terminalContainer->termWidget())
+    if (!m_terminalContainer)
         return;
     m_terminalContainer->setFocus(Qt::OtherFocusReason);
 }
 
 bool TerminalWindow::hasFocus() const
 {
-    if (!m_terminalContainer || !m_terminalContainer->termWidget())
+    if (!m_terminalContainer || !m_terminalContainer->isInitialized())
         return false;
     return m_terminalContainer->hasFocus();
 }
@@ -8,28 +8,54 @@
 #include <coreplugin/outputwindow.h>
 #include <coreplugin/ioutputpane.h>
 
+#include <QFont>
+#include <QHash>
+#include <QPointer>
+#include <QStringList>
+
 QT_FORWARD_DECLARE_CLASS(QLabel)
+QT_FORWARD_DECLARE_CLASS(QModelIndex)
 QT_FORWARD_DECLARE_CLASS(QSettings)
 QT_FORWARD_DECLARE_CLASS(QVBoxLayout)
 QT_FORWARD_DECLARE_CLASS(QTermWidget)
 QT_FORWARD_DECLARE_CLASS(QToolButton)
 QT_FORWARD_DECLARE_CLASS(QTabWidget)
+QT_FORWARD_DECLARE_CLASS(QTimer)
 QT_FORWARD_DECLARE_CLASS(QComboBox)
 
-class QFileInfo;
+template <typename T>
+class QFutureWatcher;
+
+namespace Core { class IEditor; }
 
 namespace Terminal {
 namespace Internal {
 
+class ColorSchemeCatalog;
+class FindInTerminals;
+class ProjectFileIndex;
+class ShellPool;
+class TerminalDiagnostics;
+class TerminalListModel;
+class TerminalSession;
+
 class TerminalContainer : public QWidget
 {
     Q_OBJECT
 
 public:
     TerminalContainer(QWidget *parent, QComboBox *m_toolbarTerminalsComboBox);
-    QTermWidget *initializeTerm(const QString &workingDirectory = QString());
+    ~TerminalContainer() override;
+    bool isInitialized() const;
+    void initialize();
+    void setSessionEnabled(bool enabled);
+    QTermWidget *initializeTerm(const QString &workingDirectory = QString(),
+                                bool startShell = true);
+    // The environment the shells of the terminals are started with.
+    static QStringList shellEnvironment();
 
     QTermWidget *termWidget();
+    TerminalListModel *terminalList() const;
     QString currentDocumentPath() const;
     void closeAllTerminals();
     void nextTerminal();
@@ -41,7 +67,7 @@ public:
 signals:
     void termWidgetChanged(QTermWidget * termWdiget);
     void finished();
-    void tabsUpdated(int currentIndex, QList<QString> tabNames);
+    void popupRequested();
 
 public slots:
     void setCurrentIndex(int index);
@@ -50,6 +76,15 @@ public slots:
     void toggleShowTabs();
     void increaseFont();
     void decreaseFont();
+    void contextMenuAboutToShow();
+    void contextMenuAboutToHide();
+    void showDiagnostics();
+    void measureInputLatency();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void focusInEvent(QFocusEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void contextMenuRequested(const QPoint &);
@@ -57,6 +92,11 @@ private slots:
     void copyAvailable(bool);
     void openSelectedFile();
     void copyInvoked();
+    void saveScrollback();
+    void openScrollbackInEditor();
+    void scrollbackEditorsClosed(const QList<Core::IEditor *> &editors);
+    void setOutputLogged(bool logged);
+    void setDiagnosticsParsed(bool parsed);
     void pasteInvoked();
     void closeTerminalId(int index);
     void currentTabChanged(int index);
@@ -64,21 +104,72 @@ private slots:
     void tabBarDoubleClick(int index);
     void moveTerminalLeft();
     void moveTerminalRight();
+    void findInAllTerminals();
+    void settingChanged(const QString &key, const QVariant &value);
+    void saveSession();
+    void sessionLoaded(const QString &session);
 
 private:
+    enum AppearanceChange {
+        FontStale = 0x1,
+        ColorSchemeStale = 0x2
+    };
+
     void setTabActions();
-    QFileInfo getSelectedFilePath();
+    void applyFontChange();
+    void markAppearanceStale(int what);
+    void applyAppearance(QTermWidget *terminal);
+    void showSearchHit(QTermWidget *terminal, qint64 line, int column, int length);
+    void updateRenderSuspension();
+    void setHibernationDelay(int seconds);
+    void hibernateIdleTerminals();
+    QTermWidget *acquireTerm(const QString &workingDirectory = QString());
+    void setupTerm(QTermWidget *termWidget);
+    int restoreTerminals();
+    QByteArray terminalSignature() const;
+    void startFileResolution();
+    void cancelFileResolution();
+    void fileResolved();
     void fillColorSchemeMenu();
     void renameTerminal(int index);
-    void notifyTabsUpdated();
+    void terminalsInserted(const QModelIndex &parent, int first, int last);
+    void terminalsRemoved(const QModelIndex &parent, int first, int last);
+    void terminalsMoved(const QModelIndex &parent, int start, int end,
+                        const QModelIndex &destination, int row);
+    void terminalsChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
     QVBoxLayout *m_layout;
     QTabWidget *m_tabWidget;
+    QWidget *m_placeholder;
     QComboBox *m_toolbarTerminalsComboBox;
+    ProjectFileIndex *m_fileIndex;
+    QFutureWatcher<QString> *m_fileResolver;
+    ShellPool *m_shellPool;
+    TerminalListModel *m_terminalList;
+    FindInTerminals *m_findInTerminals;
+    QPointer<TerminalDiagnostics> m_diagnostics;
+    ColorSchemeCatalog *m_colorSchemeCatalog;
+    TerminalSession *m_session;
+    QTimer *m_fontChangeTimer;
+    QTimer *m_hibernationTimer;
+    qint64 m_hibernateAfterMs;
+    QHash<QTermWidget *, int> m_staleAppearance;
+    QFont m_terminalFont;
+    QString m_resolvedFile;
+    QStringList m_scrollbackFiles;
+    bool m_openWhenResolved;
+    bool m_firstPaintPending;
+    bool m_suspendHiddenTabs;
+    bool m_sessionEnabled;
     QAction *m_openSelection;
+    QAction *m_openResolvedFile;
     QAction *m_showHideTabs;
     QAction *m_copy;
     QAction *m_paste;
+    QAction *m_saveScrollback;
+    QAction *m_openScrollback;
+    QAction *m_logOutput;
+    QAction *m_parseDiagnostics;
     QAction *m_increaseFont;
     QAction *m_decreaseFont;
     QAction *m_newTerminal;
@@ -89,6 +180,8 @@ private:
     QAction *m_moveTerminalRight;
     QAction *m_moveTerminalLeft;
     QAction *m_closeAllTerminals;
+    QAction *m_findInAllTerminals;
+    QAction *m_measureInputLatency;
     QMenu *m_colorSchemes;
     QString m_currentColorScheme;
 };
@@ -119,7 +212,6 @@ public:
 private slots:
     void terminalFinished();
     void sync();
-    void tabsUpdated(int currentIndex, QList<QString> tabNames);
 
 private:
     Core::IContext *m_context;